@@ -1,45 +1,11 @@
-
-#include <emscripten.h>
-#include <emscripten/bind.h>
-#include <emscripten/val.h>
-#include <flecs.h>
-#include <string>
-
 #include "assets.h"
-#include "game/common.h"
-#include "web/input.h"
-#include "web/render.h"
-
-flecs::world *gWorld = nullptr;
-
-void main_loop(void *ecsRaw) {
-  flecs::world ecs{static_cast<flecs::world_t *>(ecsRaw)};
-  ecs.progress();
-}
-
-int main_init(ecs_world_t *world, ecs_app_desc_t *desc) {
-  emscripten_set_main_loop_arg(main_loop, world, 60, 1);
-  return 0;
-}
 
-void loadAssets(flecs::world &ecs);
-int main(void) {
-  printf("Start\n");
-  gWorld = new flecs::world{};
-
-  gWorld->import <flecs::monitor>();
-  loadAssets(*gWorld);
-  ld53::render::initRender(*gWorld);
-  ld53::game::initGame(*gWorld);
-  ld53::input::initInput(*gWorld);
-
-  ecs_app_set_run_action(main_init);
+#include "game/common.h"
+#include "render/render.h"
 
-  return gWorld->app().enable_rest().run();
-}
+namespace ld53::assets {
 
 void loadAssets(flecs::world &ecs) {
-  using namespace ld53::assets;
   using namespace ld53::game;
   ecs.entity<Tutorial>().emplace<ld53::render::ImageAsset>("tutorial.png");
   ecs.entity<EndingScreen>().emplace<ld53::render::ImageAsset>("ending.png");
@@ -161,26 +127,4 @@ void loadAssets(flecs::world &ecs) {
       .emplace<ld53::render::ImageTile>(16, 3)
       .emplace<ld53::render::AnimatedTile>(4, 8.0f);
 }
-
-namespace ld53 {
-std::string findLoc() {
-  auto params =
-      emscripten::val::global("URLSearchParams")
-          .new_(emscripten::val::global("document")["location"]["search"]);
-  auto wasmUrl = params.call<emscripten::val>("get", emscripten::val("wasm"));
-  if (!wasmUrl.isString()) {
-    printf("Missing wasm url\n");
-    return "./data/";
-  }
-  auto wasm = wasmUrl.as<std::string>();
-  auto pos = wasm.find_last_of('/');
-  auto url = wasm.substr(0, pos) + "/../data/";
-  printf("URL: %s\n", url.c_str());
-  return url;
-}
-
-std::string locateFile(const char *path) {
-  static std::string scriptLoc = findLoc();
-  return scriptLoc + path;
-}
-} // namespace ld53
+} // namespace ld53::assets
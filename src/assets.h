@@ -1,5 +1,7 @@
 #pragma once
 
+#include <flecs.h>
+
 namespace ld53::assets {
 struct Tutorial {};
 struct EndingScreen {};
@@ -42,4 +44,5 @@ struct Tileset {
   struct WireLR {};
 };
 
+void loadAssets(flecs::world &ecs);
 } // namespace ld53::assets
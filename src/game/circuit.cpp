@@ -0,0 +1,154 @@
+#include "circuit.h"
+#include "assets.h"
+#include "common.h"
+#include "room.h"
+#include "render/render.h"
+
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+namespace ld53::game {
+
+void compileCircuit(flecs::entity room) {
+  std::vector<flecs::entity> members;
+  std::unordered_map<flecs::entity_t, int> index;
+  std::vector<std::vector<int>> incoming;
+  auto node = [&](flecs::entity e) {
+    auto [it, added] = index.emplace(e, (int)members.size());
+    if (added) {
+      members.push_back(e);
+      incoming.emplace_back();
+    }
+    return it->second;
+  };
+
+  int edgeCount = 0;
+  room.children([&](flecs::entity child) {
+    if (child.has<WeightActivated>() || child.has<Logic>())
+      node(child);
+    child.each<ConnectedTo>([&](flecs::entity target) {
+      int from = node(child);
+      int to = node(target);
+      incoming[to].push_back(from);
+      edgeCount++;
+    });
+  });
+  if (members.empty())
+    return;
+  if (members.size() > MAX_CIRCUIT_NODES || edgeCount > MAX_CIRCUIT_EDGES) {
+    printf("Circuit in %s is too large\n", room.path().c_str());
+    return;
+  }
+
+  // Kahn's algorithm, keeping declaration order between independent nodes
+  std::vector<int> remaining(members.size());
+  std::vector<std::vector<int>> outgoing(members.size());
+  for (size_t i = 0; i < members.size(); i++) {
+    remaining[i] = (int)incoming[i].size();
+    for (auto from : incoming[i])
+      outgoing[from].push_back((int)i);
+  }
+  std::vector<int> order;
+  for (size_t i = 0; i < members.size(); i++) {
+    if (remaining[i] == 0)
+      order.push_back((int)i);
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    for (auto to : outgoing[order[i]]) {
+      if (--remaining[to] == 0)
+        order.push_back(to);
+    }
+  }
+  if (order.size() != members.size()) {
+    printf("Circuit in %s has a loop\n", room.path().c_str());
+    return;
+  }
+
+  std::vector<uint16_t> position(members.size());
+  for (size_t i = 0; i < order.size(); i++)
+    position[order[i]] = (uint16_t)i;
+
+  Circuit circuit;
+  circuit.nodeCount = (uint16_t)order.size();
+  uint16_t edge = 0;
+  for (size_t i = 0; i < order.size(); i++) {
+    auto e = members[order[i]];
+    auto &n = circuit.nodes[i];
+    if (e.has<WeightActivated>()) {
+      n.op = LogicOp::Input;
+    } else if (auto logic = e.get<Logic>()) {
+      n.op = logic->op;
+    } else if (e.has<Inverted>()) {
+      n.op = LogicOp::Not;
+    } else {
+      n.op = LogicOp::Or;
+    }
+    n.firstInput = edge;
+    n.inputCount = (uint8_t)incoming[order[i]].size();
+    for (auto from : incoming[order[i]])
+      circuit.inputs[edge++] = position[from];
+    e.set<CircuitNode>({(uint16_t)i});
+  }
+  circuit.settle();
+  room.set<Circuit>(circuit);
+}
+
+void initCircuit(flecs::world &ecs) {
+  ecs.component<LogicOp>();
+  ecs.component<Logic>().member<LogicOp>("op");
+  ecs.component<CircuitNode>().member<uint16_t>("index");
+  ecs.component<Circuit>().add(EcsAlwaysOverride);
+
+  // Gates are settled from the circuit once bound as logic may start them in
+  // a different state to their prefab
+  ecs.system<Circuit, const CircuitNode>("bindCircuitNodes")
+      .kind(flecs::PreUpdate)
+      .term_at(1)
+      .parent()
+      .without<CircuitNode::Bound>()
+      .each([](flecs::entity e, Circuit &circuit, const CircuitNode &node) {
+        circuit.entities[node.index] = e;
+        e.add<CircuitNode::Bound>();
+        if (e.has<Gate>())
+          e.add<Gate::Dirty>();
+      });
+
+  ecs.system<Circuit>("evaluateCircuits")
+      .kind(flecs::OnValidate)
+      .each([](flecs::entity e, Circuit &circuit) {
+        auto ecs = e.world();
+        circuit.evaluate([&](flecs::entity_t changed) {
+          auto target = ecs.entity(changed);
+          if (target.has<Gate>())
+            target.add<Gate::Dirty>();
+        });
+      });
+
+  ecs.system<const Circuit, const CircuitNode, RoomObjects, const RoomSlot>(
+         "updateGates")
+      .kind(flecs::OnValidate)
+      .term_at(1)
+      .parent()
+      .term_at(3)
+      .parent()
+      .with<Gate>()
+      .with<Gate::Dirty>()
+      .each([](flecs::entity e, const Circuit &circuit, const CircuitNode &node,
+               RoomObjects &objects, const RoomSlot &slot) {
+        // Wait until the gate is in the room map so its slot gets the type
+        if (slot.index == NO_SLOT)
+          return;
+        bool open = circuit.value(node.index);
+        auto type = open ? TileType::None : TileType::Solid;
+        if (open) {
+          e.add<render::Image, assets::Tileset::GateOpened>();
+        } else {
+          e.add<render::Image, assets::Tileset::Gate>();
+        }
+        e.add(type);
+        objects.set_type(slot.index, type);
+        e.remove<Gate::Dirty>();
+      });
+}
+} // namespace ld53::game
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <flecs.h>
+
+namespace ld53::game {
+
+constexpr int MAX_CIRCUIT_NODES = 128;
+constexpr int MAX_CIRCUIT_EDGES = 256;
+constexpr uint16_t NO_NODE = 0xFFFF;
+
+enum class LogicOp : uint8_t {
+  // Driven by a pressure plate
+  Input,
+  // On when any input is on
+  Or,
+  // On when every input is on
+  And,
+  // On when no input is on
+  Not,
+  // Turns on with its inputs and stays on
+  Latch,
+};
+
+// Logic node placed in a room and wired up with ConnectedTo like plates and
+// gates are
+struct Logic {
+  LogicOp op;
+};
+
+// Index of a plate, logic node or gate in its room's Circuit. Set on the
+// prefab children so every instance shares the same layout.
+struct CircuitNode {
+  struct Bound {};
+
+  uint16_t index{NO_NODE};
+};
+
+// A room's plates, logic and gates compiled into a topologically sorted list
+// when the room prefab is made. Changing an input only marks it, evaluate
+// then walks forward once from the first changed node. Trivially copyable so
+// it is instanced along with the room.
+struct Circuit {
+  struct Node {
+    LogicOp op;
+    bool value;
+    uint8_t inputCount;
+    uint16_t firstInput;
+  };
+
+  std::array<Node, MAX_CIRCUIT_NODES> nodes{};
+  std::array<uint16_t, MAX_CIRCUIT_EDGES> inputs{};
+  // Entities of this instance, filled in as they are bound
+  std::array<flecs::entity_t, MAX_CIRCUIT_NODES> entities{};
+  std::array<bool, MAX_CIRCUIT_NODES> changed{};
+  uint16_t nodeCount{0};
+  uint16_t firstChanged{NO_NODE};
+
+  bool value(uint16_t node) const { return nodes[node].value; }
+
+  void set_input(uint16_t node, bool value) {
+    auto &n = nodes[node];
+    if (n.op != LogicOp::Input || n.value == value)
+      return;
+    n.value = value;
+    changed[node] = true;
+    if (node < firstChanged)
+      firstChanged = node;
+  }
+
+  // Calls `onChange(entity)` for every bound node that was recomputed to a
+  // new value
+  template <class F> void evaluate(F &&onChange) {
+    if (firstChanged == NO_NODE)
+      return;
+    for (int i = firstChanged; i < nodeCount; i++) {
+      auto &n = nodes[i];
+      if (n.op == LogicOp::Input)
+        continue;
+      bool dirty = false;
+      for (int j = 0; j < n.inputCount; j++)
+        dirty |= changed[inputs[n.firstInput + j]];
+      if (!dirty)
+        continue;
+      bool value = compute(n);
+      if (value == n.value)
+        continue;
+      n.value = value;
+      changed[i] = true;
+      if (entities[i])
+        onChange(entities[i]);
+    }
+    for (int i = firstChanged; i < nodeCount; i++)
+      changed[i] = false;
+    firstChanged = NO_NODE;
+  }
+
+  // Recomputes every node, used once the circuit has been built
+  void settle() {
+    for (int i = 0; i < nodeCount; i++) {
+      if (nodes[i].op != LogicOp::Input)
+        nodes[i].value = compute(nodes[i]);
+    }
+  }
+
+  // Value of a node given its current value and how many of its inputs are
+  // on
+  static bool apply(LogicOp op, bool current, int on, int count) {
+    switch (op) {
+    case LogicOp::Input:
+      return current;
+    case LogicOp::Or:
+      return on > 0;
+    case LogicOp::And:
+      return count > 0 && on == count;
+    case LogicOp::Not:
+      return on == 0;
+    case LogicOp::Latch:
+      return current || on > 0;
+    }
+    return false;
+  }
+
+private:
+  bool compute(const Node &n) const {
+    int on = 0;
+    for (int j = 0; j < n.inputCount; j++)
+      on += nodes[inputs[n.firstInput + j]].value;
+    return apply(n.op, n.value, on, n.inputCount);
+  }
+};
+
+// Builds the circuit for a room prefab from the ConnectedTo wiring of its
+// children
+void compileCircuit(flecs::entity room);
+
+void initCircuit(flecs::world &ecs);
+} // namespace ld53::game
@@ -1,14 +1,211 @@
 
 #include "common.h"
 #include "assets.h"
+#include "circuit.h"
 #include "player.h"
 #include "room.h"
-#include "web/render.h"
+#include "undo.h"
+#include "render/render.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 
 namespace ld53::game {
 
+namespace {
+
+// MovingState is exclusive, so only a change is worth a command
+void setMovingState(flecs::entity e, MovingState state) {
+  if (!e.has(state))
+    e.add(state);
+}
+
+// A move an object wants to make this tick, pointing straight at its
+// components so resolving it writes them in place
+struct Move {
+  flecs::entity_t entity;
+  GridPosition *grid;
+  GridPosition *prev;
+  RoomSlot *slot;
+  bool player;
+};
+
+// Scratch for resolveMovement, refilled for every room every tick
+std::array<Move, MAX_ROOM_OBJECTS> pendingMoves;
+
+bool inRoom(int x, int y) {
+  return x >= 0 && y >= 0 && x < ROOM_WIDTH && y < ROOM_HEIGHT;
+}
+
+int sign(int value) { return (value > 0) - (value < 0); }
+
+// First pushable object in a cell, NO_SLOT if there isn't one. The cell has
+// to be in the room.
+uint16_t findPushable(flecs::world &ecs, const RoomObjects &objects, int x,
+                      int y) {
+  for (auto slot = objects.heads[x + y * ROOM_WIDTH]; slot != NO_SLOT;
+       slot = objects.slots[slot].next) {
+    if (ecs.entity(objects.slots[slot].entity).has<Pushable>())
+      return slot;
+  }
+  return NO_SLOT;
+}
+
+// Moves a pushed object's slot and cell together. Its cells are written in
+// place so later moves in the pass see them, waking it is deferred and lands
+// at the sync point resolveMovement declares, before moveTowardsGrid runs.
+void placePushed(flecs::world &ecs, RoomObjects &objects, uint16_t slot,
+                 int x, int y) {
+  auto e = ecs.entity(objects.slots[slot].entity);
+  objects.move(slot, x, y);
+  auto previous = ecs.pair<GridPosition, Previous>();
+  *e.get_ref<GridPosition>().get() = {x, y};
+  *flecs::ref<GridPosition>(ecs.c_ptr(), e, previous).get() = {x, y};
+  e.remove<AtRest>();
+  touchUndo(e);
+}
+
+// Pushes the line of pushable objects starting at (x, y) one cell along
+// (dx, dy), but only if the cell past the last of them is free
+void pushChain(flecs::world &ecs, RoomObjects &objects, int x, int y, int dx,
+               int dy) {
+  int length = 0;
+  while (inRoom(x + dx * length, y + dy * length) &&
+         findPushable(ecs, objects, x + dx * length, y + dy * length) !=
+             NO_SLOT) {
+    length++;
+    if (!inRoom(x + dx * length, y + dy * length))
+      return;
+  }
+  if (!length || objects.is_solid(x + dx * length, y + dy * length, false))
+    return;
+  // Furthest first, so each object lands in a cell already emptied
+  for (int i = length; i-- > 0;) {
+    int cx = x + dx * i, cy = y + dy * i;
+    for (auto slot = findPushable(ecs, objects, cx, cy); slot != NO_SLOT;
+         slot = findPushable(ecs, objects, cx, cy))
+      placePushed(ecs, objects, slot, cx + dx, cy + dy);
+  }
+}
+
+// Applies every move wanted in a room in one ordered pass, the player's
+// first, then by slot and objects still to be placed (which share NO_SLOT)
+// by entity, so the outcome never depends on table order. Each move is
+// checked against the room map as the moves before it left it, so two
+// objects can't step into the same solid cell and pushers move the whole
+// line in front of them before stepping in behind it.
+void resolveMovement(const flecs::query<GridPosition, GridPosition, RoomSlot>
+                         &movers,
+                     flecs::entity room, RoomObjects &objects) {
+  auto ecs = room.world();
+  auto player = ecs.entity<Player>();
+  size_t count = 0;
+  movers.iter().set_group(room).each(
+      [&](flecs::entity e, GridPosition &grid, GridPosition &prev,
+          RoomSlot &slot) {
+        if (slot.index != NO_SLOT && grid.x == prev.x && grid.y == prev.y)
+          return;
+        // Packs can't hold more objects than a room has slots, so this only
+        // drops moves from objects added by hand
+        if (count == pendingMoves.size())
+          return;
+        pendingMoves[count++] = {e, &grid, &prev, &slot, e == player};
+      });
+  std::sort(pendingMoves.begin(), pendingMoves.begin() + count,
+            [](const Move &a, const Move &b) {
+              if (a.player != b.player)
+                return a.player;
+              if (a.slot->index != b.slot->index)
+                return a.slot->index < b.slot->index;
+              return a.entity < b.entity;
+            });
+
+  for (size_t i = 0; i < count; i++) {
+    auto &move = pendingMoves[i];
+    auto &grid = *move.grid;
+    auto &prev = *move.prev;
+    auto e = ecs.entity(move.entity);
+    bool placed = move.slot->index == NO_SLOT;
+    // Already pushed into place by a move before it
+    if (!placed && grid.x == prev.x && grid.y == prev.y)
+      continue;
+    touchUndo(e);
+
+    // Objects placed from nowhere have nothing to push or fall back to.
+    // Packs needn't wall their borders, so a step can leave the room.
+    bool from = prev.x >= 0 && prev.y >= 0;
+    if (from && !placed && inRoom(grid.x, grid.y) && e.has<CanPush>())
+      pushChain(ecs, objects, grid.x, grid.y, sign(grid.x - prev.x),
+                sign(grid.y - prev.y));
+    // An object's own slot is still in its previous cell here so it never
+    // blocks itself
+    if (from && (!inRoom(grid.x, grid.y) ||
+                 objects.is_solid(grid.x, grid.y, move.player))) {
+      grid = prev;
+      e.remove<Velocity>();
+    }
+
+    if (placed) {
+      auto ty = e.get<TileType>();
+      move.slot->index = objects.insert(grid.x, grid.y, e,
+                                        ty ? *ty : TileType::None,
+                                        e.has<Weighted>());
+      // Otherwise it would be gathered and fail again every tick
+      if (move.slot->index == NO_SLOT) {
+        printf("Room %s is full, disabling %s\n", room.path().c_str(),
+               e.path().c_str());
+        e.disable();
+      }
+    } else if (grid.x != prev.x || grid.y != prev.y) {
+      objects.move(move.slot->index, grid.x, grid.y);
+    }
+    prev = grid;
+  }
+}
+
+} // namespace
+
+uint64_t hashGameState(flecs::world &ecs) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      hash ^= (value >> (i * 8)) & 0xFF;
+      hash *= 1099511628211ull;
+    }
+  };
+  auto mixObject = [&](flecs::entity e) {
+    auto grid = e.get<GridPosition>();
+    auto pos = e.get<Position>();
+    mix(grid && pos);
+    if (!grid || !pos)
+      return;
+    mix((uint32_t)grid->x);
+    mix((uint32_t)grid->y);
+    mix((uint32_t)pos->x);
+    mix((uint32_t)pos->y);
+    mix(e.has(flecs::Disabled));
+    mix(e.has<MailBox::Full>());
+  };
+
+  // Entity ids differ between builds as each platform registers its own
+  // components first, so rooms are hashed by pack index and objects by
+  // their snapshot index, in that order
+  auto type = ecs.singleton<CurrentRoomType>().target<CurrentRoomType>();
+  auto pack = type ? type.get<PackRoom>() : nullptr;
+  mix(pack ? pack->index : NO_ROOM);
+  mixObject(ecs.entity<Player>());
+  auto room = ecs.singleton<CurrentRoom>().target<CurrentRoom>();
+  // Only missing on the tick a room is entered, when nothing has moved yet
+  auto snapshot = room ? room.get<RoomSnapshot>() : nullptr;
+  for (uint16_t i = 0; snapshot && i < snapshot->count; i++) {
+    mix(i);
+    mixObject(ecs.entity(snapshot->entries[i].entity));
+  }
+  return hash;
+}
+
 void initGame(flecs::world &ecs) {
   ecs.component<Position>().member<int>("x").member<int>("y");
   ecs.component<TileType>().add(flecs::Exclusive);
@@ -28,7 +225,9 @@ void initGame(flecs::world &ecs) {
       .member<flecs::entity_view>("idle_up")
       .member<flecs::entity_view>("idle_left")
       .member<flecs::entity_view>("idle_right")
-      .add_second<LastDirAnimation>(flecs::With);
+      .add_second<LastDirAnimation>(flecs::With)
+      .add_second<AnimationController>(flecs::With);
+  ecs.component<AnimationController>().member<flecs::entity_view>("clip");
 
   ecs.system<const Velocity, GridPosition>("moveVelocity")
       .with(MovingState::Inactive)
@@ -49,156 +248,105 @@ void initGame(flecs::world &ecs) {
       .without<GridPosition, Previous>()
       .each([](flecs::entity e, const GridPosition &pos) {
         e.emplace<GridPosition, Previous>(-1, -1);
+        e.add<RoomSlot>();
       });
 
-  ecs.system<const Room, const RoomObjects, GridPosition, const GridPosition>(
-         "validateMovement")
+  // Objects that might move this tick, grouped by the room they are in
+  auto movers = ecs.query_builder<GridPosition, GridPosition, RoomSlot>()
+                    .term_at(2)
+                    .second<Previous>()
+                    .without<AtRest>()
+                    .group_by(flecs::ChildOf)
+                    .build();
+  ecs.system<RoomObjects>("resolveMovement")
       .kind(flecs::PostUpdate)
-      .term_at(1)
-      .parent()
-      .term_at(2)
-      .parent()
-      .term_at(4)
-      .second<Previous>()
-      .each([](flecs::entity e, const Room &room, const RoomObjects &objs,
-               GridPosition &pos, const GridPosition &prev) {
-        auto tile = e.world().entity(room.get_tile(pos.x, pos.y));
-        auto isPlayer = e.world().entity<Player>() == e;
-        auto ty = tile.get<TileType>();
-        if (ty && (*ty == TileType::Solid ||
-                   (isPlayer && *ty == TileType::SolidPlayer))) {
-          pos = prev;
-          e.remove<Velocity>();
-          return;
-        }
-        auto objects = objs.get_objects(pos.x, pos.y);
-        for (auto &ent : objects) {
-          auto obj = e.world().entity(ent);
-          if (e == obj)
-            continue;
-          auto ty = obj.get<TileType>();
-          if (ty && (*ty == TileType::Solid ||
-                     (isPlayer && *ty == TileType::SolidPlayer))) {
-            pos = prev;
-            e.remove<Velocity>();
-            break;
-          }
-        }
+      .write<AtRest>()
+      .each([movers](flecs::entity room, RoomObjects &objects) {
+        resolveMovement(movers, room, objects);
       });
 
   ecs.system<const GridPosition, const Position, const AnimationSet,
-             LastDirAnimation>("updateMovementAnimation")
+             LastDirAnimation, AnimationController>("updateMovementAnimation")
       .kind(flecs::PostUpdate)
+      .without<AtRest>()
       .each([](flecs::entity e, const GridPosition &grid, const Position &pos,
-               const AnimationSet &set, LastDirAnimation &dir) {
+               const AnimationSet &set, LastDirAnimation &dir,
+               AnimationController &controller) {
         int targetX = grid.x * 16;
         int targetY = grid.y * 16;
+        flecs::entity_view clip;
         if (targetX > pos.x) { // Right
-          if (set.walk_right)
-            e.add<render::Image>(set.walk_right);
+          clip = set.walk_right;
           dir.direction = LastDirAnimation::Direction::Right;
         } else if (targetX < pos.x) { // Left
-          if (set.walk_left)
-            e.add<render::Image>(set.walk_left);
+          clip = set.walk_left;
           dir.direction = LastDirAnimation::Direction::Left;
         } else if (targetY > pos.y) { // Down
-          if (set.walk_down)
-            e.add<render::Image>(set.walk_down);
+          clip = set.walk_down;
           dir.direction = LastDirAnimation::Direction::Down;
         } else if (targetY < pos.y) { // Up
-          if (set.walk_up)
-            e.add<render::Image>(set.walk_up);
+          clip = set.walk_up;
           dir.direction = LastDirAnimation::Direction::Up;
         } else if (e.has(MovingState::Inactive)) {
           switch (dir.direction) {
           case LastDirAnimation::Direction::Right:
-            if (set.idle_right)
-              e.add<render::Image>(set.idle_right);
+            clip = set.idle_right;
             break;
           case LastDirAnimation::Direction::Left:
-            if (set.idle_left)
-              e.add<render::Image>(set.idle_left);
+            clip = set.idle_left;
             break;
           case LastDirAnimation::Direction::Down:
-            if (set.idle_down)
-              e.add<render::Image>(set.idle_down);
+            clip = set.idle_down;
             break;
           case LastDirAnimation::Direction::Up:
-            if (set.idle_up)
-              e.add<render::Image>(set.idle_up);
+            clip = set.idle_up;
             break;
           }
         }
+        if (clip && clip.id() != controller.clip.id()) {
+          e.add<render::Image>(clip);
+          controller.clip = clip;
+        }
       });
 
   ecs.system<const GridPosition, Position>("moveTowardsGrid")
       .kind(flecs::PostUpdate)
+      .without<AtRest>()
       .each([](flecs::entity e, const GridPosition &grid, Position &pos) {
         int targetX = grid.x * 16;
         int targetY = grid.y * 16;
         if (targetX != pos.x) {
-          e.add(MovingState::Active);
+          setMovingState(e, MovingState::Active);
           pos.x += std::copysign(1, targetX - pos.x);
         } else if (targetY != pos.y) {
-          e.add(MovingState::Active);
+          setMovingState(e, MovingState::Active);
           pos.y += std::copysign(1, targetY - pos.y);
         } else {
-          e.add(MovingState::Inactive);
+          setMovingState(e, MovingState::Inactive);
         }
       });
 
-  ecs.system<RoomObjects, const GridPosition, GridPosition>("removeDisabled")
+  ecs.system<RoomObjects, GridPosition, RoomSlot>("removeDisabled")
       .kind(flecs::PostUpdate)
       .term_at(1)
       .parent()
-      .term_at(3)
+      .term_at(2)
       .second<Previous>()
       .with(flecs::Disabled)
-      .each([](flecs::entity e, RoomObjects &room, const GridPosition &pos,
-               GridPosition &prev) {
-        if (prev.x != -1) {
-          auto &prevObjs = room.get_objects(prev.x, prev.y);
-          auto it = std::find(prevObjs.begin(), prevObjs.end(), e);
-          if (it != prevObjs.end())
-            prevObjs.erase(it);
-          prev.x = -1;
-          prev.y = -1;
-        }
-        auto &objs = room.get_objects(pos.x, pos.y);
-        auto it = std::find(objs.begin(), objs.end(), e);
-        if (it != objs.end())
-          objs.erase(it);
-      });
-  ecs.system<RoomObjects, const GridPosition, const GridPosition>(
-         "updateObjectRoomMap")
-      .kind(flecs::PostUpdate)
-      .term_at(1)
-      .parent()
-      .term_at(3)
-      .second<Previous>()
-      .each([](flecs::entity e, RoomObjects &room, const GridPosition &pos,
-               const GridPosition &prev) {
-        if (pos.x == prev.x && pos.y == prev.y)
-          return;
-        if (prev.x != -1) {
-          auto &prevObjs = room.get_objects(prev.x, prev.y);
-          auto it = std::find(prevObjs.begin(), prevObjs.end(), e);
-          if (it != prevObjs.end())
-            prevObjs.erase(it);
+      .each([](RoomObjects &room, GridPosition &prev, RoomSlot &slot) {
+        if (slot.index != NO_SLOT) {
+          room.remove(slot.index);
+          slot.index = NO_SLOT;
         }
-        auto &objs = room.get_objects(pos.x, pos.y);
-        objs.push_back(e);
+        prev.x = -1;
+        prev.y = -1;
       });
-  ecs.system<const GridPosition, GridPosition>("commitGridPos")
-      .kind(flecs::PostUpdate)
-      .term_at(2)
-      .second<Previous>()
-      .each([](const GridPosition &pos, GridPosition &prev) { prev = pos; });
   ecs.system<>("makeWorldPosition")
       .with<Position>()
       .without<Position, World>()
       .write<Position, World>()
       .each([](flecs::entity e) { e.add<Position, World>(); });
+  // Rooms never move, so a child at rest keeps its world position
   ecs.system<const Position, Position, const Position>("updateWorldPosition")
       .kind(flecs::PostUpdate)
       .term_at(2)
@@ -210,6 +358,7 @@ void initGame(flecs::world &ecs) {
       .parent()
       .cascade()
       .optional()
+      .without<AtRest>()
       .iter([](flecs::iter &it, const Position *pos, Position *outPosition,
                const Position *parentPosition) {
         if (parentPosition) {
@@ -224,66 +373,54 @@ void initGame(flecs::world &ecs) {
           }
         }
       });
+  // Last in the phase so it sees the positions everything above settled on.
+  // Moving objects are stepped into Inactive a tick after they arrive. The
+  // player is left out, movePlayer writes its cell directly and the removal
+  // would only land after the rest of the tick had skipped it.
+  ecs.system<const GridPosition, const GridPosition, const Position>(
+         "settleAtRest")
+      .kind(flecs::PostUpdate)
+      .term_at(2)
+      .second<Previous>()
+      .with(MovingState::Inactive)
+      .without<Velocity>()
+      .without<AtRest>()
+      .each([](flecs::entity e, const GridPosition &grid,
+               const GridPosition &prev, const Position &pos) {
+        if (e == e.world().entity<Player>())
+          return;
+        if (grid.x == prev.x && grid.y == prev.y && pos.x == grid.x * 16 &&
+            pos.y == grid.y * 16)
+          e.add<AtRest>();
+      });
 
+  initCircuit(ecs);
   initRoom(ecs);
   initPlayer(ecs);
 
-  ecs.system<const GridPosition, const GridPosition, const RoomObjects>(
-         "pushObjects")
+  // Plates only feed the room's circuit when their pressed state flips
+  ecs.system<const GridPosition, const RoomObjects, Circuit,
+             const CircuitNode>("activateOnWeight")
       .term_at(2)
-      .second<Previous>()
-      .term_at(3)
       .parent()
-      .with<CanPush>()
-      .each([](flecs::entity e, const GridPosition &grid,
-               const GridPosition &prev, const RoomObjects &objects) {
-        auto &objs = objects.get_objects(grid.x, grid.y);
-        auto dx = grid.x - prev.x;
-        auto dy = grid.y - prev.y;
-        for (auto &o : objs) {
-          auto obj = e.world().entity(o);
-          if (!obj.has<Pushable>())
-            continue;
-
-          auto ogrid = obj.get_mut<GridPosition>();
-          ogrid->x += dx;
-          ogrid->y += dy;
-        }
-      });
-  ecs.system<const GridPosition, const RoomObjects>("activateOnWeight")
-      .term_at(2)
+      .term_at(3)
       .parent()
       .with<WeightActivated>()
       .each([](flecs::entity e, const GridPosition &grid,
-               const RoomObjects &objects) {
-        auto &objs = objects.get_objects(grid.x, grid.y);
-        bool active = false;
-        for (auto &o : objs) {
-          auto obj = e.world().entity(o);
-          if (!obj.has<Weighted>())
-            continue;
-          active = true;
-          break;
-        }
+               const RoomObjects &objects, Circuit &circuit,
+               const CircuitNode &node) {
+        bool active = objects.is_weighted(grid.x, grid.y);
+        if (active == e.has<WeightActivated::Pressed>())
+          return;
         if (active) {
+          e.add<WeightActivated::Pressed>();
           e.add<render::Image, assets::Tileset::ButtonPlatePressed>();
         } else {
+          e.remove<WeightActivated::Pressed>();
           e.add<render::Image, assets::Tileset::ButtonPlate>();
         }
-        e.each<ConnectedTo>([&](flecs::entity o) {
-          // TODO: Need to lookup due to prefabs not changing this relation
-          auto pos = o.get<GridPosition>();
-          auto &list = objects.get_objects(pos->x, pos->y);
-
-          for (auto &l : list) {
-            auto lEntity = e.world().entity(l);
-            if (active) {
-              lEntity.add<ActivatedBy>(e);
-            } else {
-              lEntity.remove<ActivatedBy>(e);
-            }
-          }
-        });
+        circuit.set_input(node.index, active);
+        touchUndo(e, true);
       });
 
   ecs.system<const GridPosition, const RoomObjects>("handInMail")
@@ -293,14 +430,15 @@ void initGame(flecs::world &ecs) {
       .without<MailBox::Full>()
       .each([](flecs::entity e, const GridPosition &grid,
                const RoomObjects &objects) {
-        auto &list = objects.get_objects(grid.x, grid.y);
-        for (auto o : list) {
+        for (auto o : objects.get_objects(grid.x, grid.y)) {
           auto obj = e.world().entity(o);
           if (!obj.has<MailObject>())
             continue;
           e.add<MailBox::Full>();
           e.add<render::Image, assets::Tileset::MailboxFull>();
           obj.disable();
+          touchUndo(e);
+          touchUndo(obj);
         }
       });
 
@@ -319,40 +457,10 @@ void initGame(flecs::world &ecs) {
         player.add<Holding>(e);
         e.world().defer_resume();
         e.disable();
+        touchUndo(e);
       });
 
-  ecs.system<>("openGate")
-      .with<Gate>()
-      .without<Inverted>()
-      .with<ActivatedBy>(flecs::Any)
-      .each([](flecs::entity e) {
-        e.add<render::Image, assets::Tileset::GateOpened>();
-        e.add(TileType::None);
-      });
-  ecs.system<>("closeGate")
-      .with<Gate>()
-      .without<Inverted>()
-      .without<ActivatedBy>(flecs::Any)
-      .each([](flecs::entity e) {
-        e.add<render::Image, assets::Tileset::Gate>();
-        e.add(TileType::Solid);
-      });
-
-  ecs.system<>("openGateInv")
-      .with<Gate>()
-      .with<Inverted>()
-      .without<ActivatedBy>(flecs::Any)
-      .each([](flecs::entity e) {
-        e.add<render::Image, assets::Tileset::GateOpened>();
-        e.add(TileType::None);
-      });
-  ecs.system<>("closeGateInv")
-      .with<Gate>()
-      .with<Inverted>()
-      .with<ActivatedBy>(flecs::Any)
-      .each([](flecs::entity e) {
-        e.add<render::Image, assets::Tileset::Gate>();
-        e.add(TileType::Solid);
-      });
+  // Last so undo sees the frame's pushes, pickups and plates
+  initUndo(ecs);
 }
 } // namespace ld53::game
\ No newline at end of file
@@ -1,4 +1,4 @@
-#pragma
+#pragma once
 
 #include <flecs.h>
 
@@ -14,6 +14,12 @@ struct GridPosition {
   int x{0}, y{0};
 };
 
+// The object's cell, previous cell and pixel position all agree, so the
+// movement systems skip it. Anything that writes an object's GridPosition or
+// Position removes it along with the write, so both land in the same merge.
+// The object settles again once it has caught up.
+struct AtRest {};
+
 enum class MovingState {
   Inactive,
   Active,
@@ -35,9 +41,12 @@ struct ConnectedTo {};
 struct Pushable {};
 struct CanPush {};
 struct Weighted {};
-struct WeightActivated {};
-struct ActivatedBy {};
-struct Gate {};
+struct WeightActivated {
+  struct Pressed {};
+};
+struct Gate {
+  struct Dirty {};
+};
 struct Inverted {};
 
 struct Holding {};
@@ -58,6 +67,12 @@ struct AnimationSet {
   flecs::entity_view idle_right{};
 };
 
+// The AnimationSet clip currently shown, so render::Image is only replaced
+// when the clip changes rather than re-added every tick
+struct AnimationController {
+  flecs::entity_view clip{};
+};
+
 struct LastDirAnimation {
   enum class Direction {
     Up,
@@ -67,5 +82,9 @@ struct LastDirAnimation {
   } direction;
 };
 
+// Hash of the state a session's outcome depends on, replays compare it to
+// check they ended up in the same place
+uint64_t hashGameState(flecs::world &ecs);
+
 void initGame(flecs::world &ecs);
 } // namespace ld53::game
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace ld53::game {
+
+// Tiles a room map can use, the order is the byte stored per cell in a level
+// pack and the index into the table of tile entities room prefabs are built
+// from
+enum class TileId : uint8_t {
+  Grass,
+  GrassWithStone,
+  GrassTall,
+  TreeTop,
+  TreeBottom,
+  TreeBoth,
+  Wall,
+  WallBottom,
+  WireTR,
+  WireLR,
+  WireTB,
+  WireTL,
+  WireBR,
+  Count,
+};
+constexpr int TILE_COUNT = (int)TileId::Count;
+
+constexpr int MAP_WIDTH = 20;
+constexpr int MAP_HEIGHT = 15;
+constexpr int MAP_CELLS = MAP_WIDTH * MAP_HEIGHT;
+using RoomMap = std::array<TileId, MAP_CELLS>;
+
+constexpr TileId tileFor(char c) {
+  switch (c) {
+  case ' ':
+    return TileId::Grass;
+  case 'v':
+    return TileId::TreeTop;
+  case '#':
+    return TileId::TreeBoth;
+  case '^':
+    return TileId::TreeBottom;
+  case 'B':
+    return TileId::WallBottom;
+  case 'W':
+    return TileId::Wall;
+  case 'L':
+    return TileId::WireTR;
+  case '-':
+    return TileId::WireLR;
+  case '|':
+    return TileId::WireTB;
+  case '/':
+    return TileId::WireTL;
+  case '=':
+    return TileId::WireBR;
+  case '@':
+    return TileId::GrassTall;
+  }
+  // Not a constant expression, so a bad map fails to compile
+  throw "Unknown map character";
+}
+
+// Roughly one in 150 grass tiles gets a stone, picked by hashing the cell so
+// a map always looks the same
+constexpr bool hasStone(uint32_t seed, int cell) {
+  uint32_t h = seed ^ ((uint32_t)cell * 0x9E3779B9u);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h % 150 == 0;
+}
+
+// Maps are 20x15 characters, anything else fails to compile
+constexpr RoomMap bakeMap(const char (&map)[MAP_CELLS + 1], uint32_t seed) {
+  RoomMap tiles{};
+  for (int i = 0; i < MAP_CELLS; i++) {
+    tiles[i] = tileFor(map[i]);
+    if (tiles[i] == TileId::Grass && hasStone(seed, i))
+      tiles[i] = TileId::GrassWithStone;
+  }
+  return tiles;
+}
+
+} // namespace ld53::game
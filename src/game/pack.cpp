@@ -0,0 +1,159 @@
+#include "pack.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace ld53::game {
+
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'L', 'D', '5', 'L'};
+constexpr size_t HEADER_SIZE = 4 + 4 + 4;
+constexpr size_t ENTRY_SIZE = 4 + 4;
+constexpr size_t ROOM_HEADER_SIZE = ROOM_NAME_SIZE + 2 + 1 + 1 + 2 + 2;
+constexpr size_t OBJECT_SIZE = 4;
+constexpr size_t LINK_SIZE = 4;
+
+void put(std::vector<uint8_t> &out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+void put_at(std::vector<uint8_t> &out, size_t at, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out[at + i] = (uint8_t)(value >> (i * 8));
+}
+
+uint64_t get(const uint8_t *data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value |= (uint64_t)data[i] << (i * 8);
+  return value;
+}
+
+} // namespace
+
+std::vector<uint8_t> encodeLevelPack(const std::vector<LevelDef> &rooms) {
+  std::vector<uint8_t> out;
+  out.insert(out.end(), MAGIC, MAGIC + 4);
+  put(out, LEVEL_PACK_VERSION, 4);
+  put(out, rooms.size(), 4);
+  out.resize(HEADER_SIZE + rooms.size() * ENTRY_SIZE);
+
+  for (size_t i = 0; i < rooms.size(); i++) {
+    auto &room = rooms[i];
+    auto start = out.size();
+    auto name = room.name.substr(0, ROOM_NAME_SIZE);
+    out.insert(out.end(), name.begin(), name.end());
+    out.resize(start + ROOM_NAME_SIZE);
+    put(out, room.next, 2);
+    put(out, (uint8_t)room.overlay, 1);
+    put(out, 0, 1);
+    put(out, room.objects.size(), 2);
+    put(out, room.links.size(), 2);
+    for (auto tile : room.tiles)
+      put(out, (uint8_t)tile, 1);
+    for (auto &object : room.objects) {
+      put(out, object.x, 1);
+      put(out, object.y, 1);
+      put(out, (uint8_t)object.kind, 1);
+      put(out, 0, 1);
+    }
+    for (auto &link : room.links) {
+      put(out, link.from, 2);
+      put(out, link.to, 2);
+    }
+    put_at(out, HEADER_SIZE + i * ENTRY_SIZE, start, 4);
+    put_at(out, HEADER_SIZE + i * ENTRY_SIZE + 4, out.size() - start, 4);
+  }
+  return out;
+}
+
+LevelObjectDef LevelView::object(int i) const {
+  auto o = objects + i * OBJECT_SIZE;
+  return {o[0], o[1], (LevelObject)o[2]};
+}
+
+LevelLink LevelView::link(int i) const {
+  auto l = links + i * LINK_SIZE;
+  return {(uint16_t)get(l, 2), (uint16_t)get(l + 2, 2)};
+}
+
+bool LevelPackView::open(const uint8_t *data, size_t size) {
+  if (size < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0)
+    return false;
+  if (get(data + 4, 4) != LEVEL_PACK_VERSION) {
+    printf("Unsupported level pack version %u\n", (uint32_t)get(data + 4, 4));
+    return false;
+  }
+  auto count = get(data + 8, 4);
+  if (count == 0 || count >= NO_ROOM ||
+      (size - HEADER_SIZE) / ENTRY_SIZE < count)
+    return false;
+  this->data = data;
+  this->size = size;
+  this->count = (uint16_t)count;
+  return true;
+}
+
+bool LevelPackView::room(int index, LevelView &out) const {
+  if (index < 0 || index >= count)
+    return false;
+  auto entry = data + HEADER_SIZE + index * ENTRY_SIZE;
+  auto offset = get(entry, 4);
+  auto length = get(entry + 4, 4);
+  if (offset > size || size - offset < length ||
+      length < ROOM_HEADER_SIZE + MAP_CELLS)
+    return false;
+
+  auto room = data + offset;
+  auto name = (const char *)room;
+  out.name = std::string_view(name, strnlen(name, ROOM_NAME_SIZE));
+  out.next = (uint16_t)get(room + ROOM_NAME_SIZE, 2);
+  out.overlay = (LevelOverlay)room[ROOM_NAME_SIZE + 2];
+  out.objectCount = (uint16_t)get(room + ROOM_NAME_SIZE + 4, 2);
+  out.linkCount = (uint16_t)get(room + ROOM_NAME_SIZE + 6, 2);
+  if (out.objectCount > MAX_PACK_OBJECTS)
+    return false;
+  if (length != ROOM_HEADER_SIZE + MAP_CELLS +
+                    out.objectCount * OBJECT_SIZE + out.linkCount * LINK_SIZE)
+    return false;
+  out.tiles = (const TileId *)(room + ROOM_HEADER_SIZE);
+  out.objects = room + ROOM_HEADER_SIZE + MAP_CELLS;
+  out.links = out.objects + out.objectCount * OBJECT_SIZE;
+  if ((out.next != NO_ROOM && out.next >= count) ||
+      out.overlay >= LevelOverlay::Count)
+    return false;
+
+  for (int i = 0; i < MAP_CELLS; i++) {
+    if (out.tiles[i] >= TileId::Count)
+      return false;
+  }
+  for (int i = 0; i < out.objectCount; i++) {
+    auto object = out.object(i);
+    if (object.x >= MAP_WIDTH || object.y >= MAP_HEIGHT ||
+        object.kind >= LevelObject::Count)
+      return false;
+  }
+  for (int i = 0; i < out.linkCount; i++) {
+    auto link = out.link(i);
+    if (link.from >= out.objectCount || link.to >= out.objectCount)
+      return false;
+  }
+  return true;
+}
+
+int LevelPackView::find(std::string_view name) const {
+  for (int i = 0; i < count; i++) {
+    auto entry = data + HEADER_SIZE + i * ENTRY_SIZE;
+    auto offset = get(entry, 4);
+    if (offset > size || size - offset < ROOM_NAME_SIZE)
+      continue;
+    auto room = (const char *)data + offset;
+    if (std::string_view(room, strnlen(room, ROOM_NAME_SIZE)) == name)
+      return i;
+  }
+  return -1;
+}
+
+} // namespace ld53::game
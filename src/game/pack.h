@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levels.h"
+
+namespace ld53::game {
+
+constexpr uint32_t LEVEL_PACK_VERSION = 1;
+constexpr uint16_t NO_ROOM = 0xFFFF;
+constexpr size_t ROOM_NAME_SIZE = 24;
+// A room's objects share its slot pool with the player, rooms with more are
+// rejected when read
+constexpr uint16_t MAX_PACK_OBJECTS = 1023;
+
+enum class LevelObject : uint8_t {
+  Mailbox,
+  Mail,
+  Box,
+  Gate,
+  GateInverted,
+  ButtonPlate,
+  LogicOr,
+  LogicAnd,
+  LogicNot,
+  LogicLatch,
+  Count,
+};
+
+// Full screen image drawn under a room's objects
+enum class LevelOverlay : uint8_t {
+  None,
+  Tutorial,
+  EndingScreen,
+  Count,
+};
+
+struct LevelObjectDef {
+  uint8_t x, y;
+  LevelObject kind;
+};
+
+// ConnectedTo from one object to another, by their index in the room
+struct LevelLink {
+  uint16_t from, to;
+};
+
+struct LevelDef {
+  std::string name;
+  RoomMap tiles{};
+  LevelOverlay overlay{LevelOverlay::None};
+  uint16_t next{NO_ROOM};
+  std::vector<LevelObjectDef> objects;
+  std::vector<LevelLink> links;
+};
+
+// Little endian: "LD5L", version, room count, then a u32 offset and size for
+// each room. A room is its name padded to 24 bytes, u16 next room, u8
+// overlay, a reserved byte, u16 object and link counts, a TileId per cell,
+// then u8 x, y, kind and a pad byte per object and u16 from, to per link.
+// The first room is where the game starts.
+std::vector<uint8_t> encodeLevelPack(const std::vector<LevelDef> &rooms);
+
+// A room read straight out of the pack's bytes
+struct LevelView {
+  std::string_view name;
+  const TileId *tiles;
+  LevelOverlay overlay;
+  uint16_t next;
+  uint16_t objectCount;
+  uint16_t linkCount;
+  const uint8_t *objects;
+  const uint8_t *links;
+
+  LevelObjectDef object(int i) const;
+  LevelLink link(int i) const;
+};
+
+// Read only view over an encoded pack that is mapped or fetched as a whole.
+// Only the header is checked up front, each room is checked when it is read
+// so opening a pack costs the same however many rooms it has.
+class LevelPackView {
+  const uint8_t *data{nullptr};
+  size_t size{0};
+  uint16_t count{0};
+
+public:
+  bool open(const uint8_t *data, size_t size);
+
+  int room_count() const { return count; }
+  bool room(int index, LevelView &out) const;
+  // Linear scan, for tools picking rooms by name
+  int find(std::string_view name) const;
+};
+
+} // namespace ld53::game
@@ -3,8 +3,9 @@
 #include "assets.h"
 #include "common.h"
 #include "room.h"
-#include "web/input.h"
-#include "web/render.h"
+#include "undo.h"
+#include "input/input.h"
+#include "render/render.h"
 
 namespace ld53::game {
 
@@ -12,6 +13,93 @@ struct PlayerMovementState {
   bool up{false}, down{false}, left{false}, right{false};
 };
 
+void handleInput(flecs::world ecs, PlayerMovementState &state,
+                 LastDirAnimation &dir, const input::InputData &data) {
+  switch (data.type) {
+  case input::InputType::Up:
+    state.up = data.pressed;
+    dir.direction = LastDirAnimation::Direction::Up;
+    break;
+  case input::InputType::Down:
+    state.down = data.pressed;
+    dir.direction = LastDirAnimation::Direction::Down;
+    break;
+  case input::InputType::Left:
+    state.left = data.pressed;
+    dir.direction = LastDirAnimation::Direction::Left;
+    break;
+  case input::InputType::Right:
+    state.right = data.pressed;
+    dir.direction = LastDirAnimation::Direction::Right;
+    break;
+  case input::InputType::Fire: {
+    auto player = ecs.entity<Player>();
+    auto mail = player.target<Holding>();
+    if (data.pressed || !mail)
+      return;
+
+    mail.enable();
+    auto playerPos = player.get<GridPosition>();
+    auto pos = mail.get_mut<GridPosition>();
+    auto posLast = mail.get_mut<GridPosition, Previous>();
+    *posLast = *playerPos;
+    auto absPos = mail.get_mut<Position>();
+    int ox = 0;
+    int oy = 0;
+    switch (dir.direction) {
+    case LastDirAnimation::Direction::Up:
+      oy = -1;
+      break;
+    case LastDirAnimation::Direction::Down:
+      oy = 1;
+      break;
+    case LastDirAnimation::Direction::Left:
+      ox = -1;
+      break;
+    case LastDirAnimation::Direction::Right:
+      ox = 1;
+      break;
+    }
+    pos->x = playerPos->x + ox;
+    pos->y = playerPos->y + oy;
+
+    absPos->x = playerPos->x * 16;
+    absPos->y = playerPos->y * 16;
+    mail.remove<AtRest>();
+
+    mail.set<Velocity>({ox, oy});
+
+    player.remove<Holding>(flecs::Wildcard);
+    touchUndo(mail);
+    break;
+  }
+  case input::InputType::Restart: {
+    if (data.pressed)
+      return;
+    // Rooms restore in place once they have a snapshot, which is only
+    // missing on the frame a room is entered
+    auto room = ecs.singleton<CurrentRoom>().target<CurrentRoom>();
+    if (!room)
+      break;
+    if (room.has<RoomSnapshot>())
+      room.add<RoomSnapshot::Restore>();
+    else if (auto type = ecs.singleton<CurrentRoomType>()
+                             .target<CurrentRoomType>()
+                             .get<PackRoom>())
+      ecs.set<ChangeRoom>({type->index});
+    break;
+  }
+  case input::InputType::Undo: {
+    if (data.pressed)
+      return;
+    auto room = ecs.singleton<CurrentRoom>().target<CurrentRoom>();
+    if (room && room.has<UndoLog>())
+      room.add<UndoLog::Undo>();
+    break;
+  }
+  }
+}
+
 void initPlayer(flecs::world &ecs) {
   ecs.component<PlayerMovementState>()
       .member<bool>("up")
@@ -19,12 +107,10 @@ void initPlayer(flecs::world &ecs) {
       .member<bool>("left")
       .member<bool>("right");
 
-  auto room = ecs.entity().is_a<InitialRoom>().child_of<RoomInstances>();
-  ecs.add<CurrentRoom>(room);
-  ecs.add<CurrentRoomType, InitialRoom>();
+  // Moved into the first room once the level pack is set
   ecs.entity<Player>()
       .emplace<Position>(18 * 16, 7 * 16)
-      .emplace<GridPosition>(16, 7)
+      .emplace<GridPosition>(PLAYER_START_X, PLAYER_START_Y)
       .add<render::Image, assets::Tileset::PlayerIdleDown>()
       .add<PlayerMovementState>()
       .add(MovingState::Inactive)
@@ -40,84 +126,21 @@ void initPlayer(flecs::world &ecs) {
         set.idle_right = ecs.entity<assets::Tileset::PlayerIdleRight>().view();
         set.walk_right = ecs.entity<assets::Tileset::PlayerWalkRight>().view();
       })
-      .add<render::Depth, render::Depth::Player>()
-      .child_of(room);
+      .add<render::Depth, render::Depth::Player>();
 
-  ecs.system<PlayerMovementState, const input::InputData, LastDirAnimation>(
-         "processPlayerInput")
+  // Drains everything the platform queued since the last frame
+  ecs.system<PlayerMovementState, LastDirAnimation>("processPlayerInput")
       .kind(flecs::PreUpdate)
       .term_at(1)
       .src<Player>()
-      .term_at(3)
+      .term_at(2)
       .src<Player>()
       .write<GridPosition, Previous>()
-      .each([](flecs::entity e, PlayerMovementState &state,
-               const input::InputData &data, LastDirAnimation &dir) {
-        auto ecs = e.world();
-        switch (data.type) {
-        case input::InputType::Up:
-          state.up = data.pressed;
-          dir.direction = LastDirAnimation::Direction::Up;
-          break;
-        case input::InputType::Down:
-          state.down = data.pressed;
-          dir.direction = LastDirAnimation::Direction::Down;
-          break;
-        case input::InputType::Left:
-          state.left = data.pressed;
-          dir.direction = LastDirAnimation::Direction::Left;
-          break;
-        case input::InputType::Right:
-          state.right = data.pressed;
-          dir.direction = LastDirAnimation::Direction::Right;
-          break;
-        case input::InputType::Fire: {
-          auto player = e.world().entity<Player>();
-          auto mail = player.target<Holding>();
-          if (data.pressed || !mail)
-            return;
-
-          mail.enable();
-          auto playerPos = player.get<GridPosition>();
-          auto pos = mail.get_mut<GridPosition>();
-          auto posLast = mail.get_mut<GridPosition, Previous>();
-          *posLast = *playerPos;
-          auto absPos = mail.get_mut<Position>();
-          int ox = 0;
-          int oy = 0;
-          switch (dir.direction) {
-          case LastDirAnimation::Direction::Up:
-            oy = -1;
-            break;
-          case LastDirAnimation::Direction::Down:
-            oy = 1;
-            break;
-          case LastDirAnimation::Direction::Left:
-            ox = -1;
-            break;
-          case LastDirAnimation::Direction::Right:
-            ox = 1;
-            break;
-          }
-          pos->x = playerPos->x + ox;
-          pos->y = playerPos->y + oy;
-
-          absPos->x = playerPos->x * 16;
-          absPos->y = playerPos->y * 16;
-
-          mail.set<Velocity>({ox, oy});
-
-          player.remove<Holding>(flecs::Wildcard);
-          break;
-        }
-        case input::InputType::Restart:
-          if (data.pressed)
-            return;
-
-          ecs.add<ChangeRoom>(
-              ecs.singleton<CurrentRoomType>().target<CurrentRoomType>());
-          break;
-        }
+      .iter([](flecs::iter &it, PlayerMovementState *state,
+               LastDirAnimation *dir) {
+        input::InputEvent event;
+        while (input::nextInput(it.world(), event))
+          handleInput(it.world(), *state, *dir, event.data);
       });
 
   ecs.system<const PlayerMovementState, GridPosition>("movePlayer")
@@ -1,51 +1,41 @@
 #include "room.h"
 
 #include <array>
-#include <unordered_map>
+#include <cstdio>
+#include <string>
+#include <vector>
 
 #include "assets.h"
+#include "game/circuit.h"
 #include "game/common.h"
 #include "game/player.h"
-#include "web/render.h"
+#include "game/undo.h"
+#include "render/render.h"
 
 namespace ld53::game {
 
-/*
-      "#^^^^^^^^^^^^^^^^^^#"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#                  #"
-      "#vvvvvvvvvvvvvvvvvv#",
-      {{' ', grass}, {'v', top}, {'#', both}, {'^', bottom}}
-*/
+static_assert(MAP_WIDTH == ROOM_WIDTH && MAP_HEIGHT == ROOM_HEIGHT);
 
-template <class T>
-flecs::entity makeRoom(flecs::world &ecs, const char *mapData,
-                       const std::unordered_map<char, flecs::entity_t> &tiles) {
-  flecs::entity e = ecs.prefab<T>();
-  auto room = e.emplace_override<Position>(0, 0)
-                  .add<render::DependsOn, assets::Tileset>()
-                  .override<render::DependsOn, assets::Tileset>()
-                  .get_mut<Room>();
-  auto stone = ecs.id<ld53::assets::Tileset::GrassWithStone>();
-  auto grass = ecs.id<ld53::assets::Tileset::Grass>();
-  for (int i = 0; i < ROOM_WIDTH * ROOM_HEIGHT; i++) {
-    room->tiles[i] = tiles.at(mapData[i]);
-    if (room->tiles[i] == grass && rand() % 150 == 0) {
-      room->tiles[i] = stone;
-    }
-  }
-  return e;
+// Tile entity for each TileId
+using TileTable = std::array<flecs::entity_t, TILE_COUNT>;
+
+TileTable tileTable(flecs::world &ecs) {
+  TileTable tiles{};
+  tiles[(int)TileId::Grass] = ecs.id<assets::Tileset::Grass>();
+  tiles[(int)TileId::GrassWithStone] =
+      ecs.id<assets::Tileset::GrassWithStone>();
+  tiles[(int)TileId::GrassTall] = ecs.id<assets::Tileset::GrassTall>();
+  tiles[(int)TileId::TreeTop] = ecs.id<assets::Tileset::TreeTop>();
+  tiles[(int)TileId::TreeBottom] = ecs.id<assets::Tileset::TreeBottom>();
+  tiles[(int)TileId::TreeBoth] = ecs.id<assets::Tileset::TreeBoth>();
+  tiles[(int)TileId::Wall] = ecs.id<assets::Tileset::Wall>();
+  tiles[(int)TileId::WallBottom] = ecs.id<assets::Tileset::WallBottom>();
+  tiles[(int)TileId::WireTR] = ecs.id<assets::Tileset::WireTR>();
+  tiles[(int)TileId::WireLR] = ecs.id<assets::Tileset::WireLR>();
+  tiles[(int)TileId::WireTB] = ecs.id<assets::Tileset::WireTB>();
+  tiles[(int)TileId::WireTL] = ecs.id<assets::Tileset::WireTL>();
+  tiles[(int)TileId::WireBR] = ecs.id<assets::Tileset::WireBR>();
+  return tiles;
 }
 
 struct Prefab {
@@ -57,41 +47,168 @@ struct Prefab {
   struct ButtonPlate {};
 };
 
+flecs::entity makeObject(flecs::world &ecs, const LevelObjectDef &object) {
+  auto e = ecs.entity();
+  auto placed = [&]() -> flecs::entity {
+    return e.emplace<GridPosition>(object.x, object.y);
+  };
+  switch (object.kind) {
+  case LevelObject::Mailbox:
+    return placed().is_a<Prefab::Mailbox>();
+  case LevelObject::Mail:
+    return placed().is_a<Prefab::Mail>();
+  case LevelObject::Box:
+    return placed().is_a<Prefab::Box>();
+  case LevelObject::Gate:
+    return placed().is_a<Prefab::Gate>();
+  case LevelObject::GateInverted:
+    return placed().is_a<Prefab::GateInverted>();
+  case LevelObject::ButtonPlate:
+    return placed().is_a<Prefab::ButtonPlate>();
+  case LevelObject::LogicOr:
+    return e.set<Logic>({LogicOp::Or});
+  case LevelObject::LogicAnd:
+    return e.set<Logic>({LogicOp::And});
+  case LevelObject::LogicNot:
+    return e.set<Logic>({LogicOp::Not});
+  case LevelObject::LogicLatch:
+    return e.set<Logic>({LogicOp::Latch});
+  case LevelObject::Count:
+    break;
+  }
+  return e;
+}
+
+flecs::entity makeRoom(flecs::world &ecs, int index, const LevelView &level) {
+  auto tiles = tileTable(ecs);
+  std::string name(level.name);
+  flecs::entity e = ecs.prefab().child_of<Rooms>();
+  if (!name.empty() && !ecs.entity<Rooms>().lookup(name.c_str()))
+    e.set_name(name.c_str());
+
+  auto room = e.emplace_override<Position>(0, 0)
+                  .set<PackRoom>({(uint16_t)index, level.next})
+                  .add<render::DependsOn, assets::Tileset>()
+                  .override<render::DependsOn, assets::Tileset>()
+                  .get_mut<Room>();
+  std::array<TileType, TILE_COUNT> types{};
+  for (int i = 0; i < TILE_COUNT; i++) {
+    auto ty = ecs.entity(tiles[i]).get<TileType>();
+    types[i] = ty ? *ty : TileType::None;
+  }
+  auto objects = e.get_mut<RoomObjects>();
+  for (int i = 0; i < ROOM_CELLS; i++) {
+    room->tiles[i] = tiles[(int)level.tiles[i]];
+    objects->add_tile(i % ROOM_WIDTH, i / ROOM_WIDTH,
+                      types[(int)level.tiles[i]]);
+  }
+
+  std::vector<flecs::entity> children(level.objectCount);
+  e.with(flecs::ChildOf, [&]() {
+    for (int i = 0; i < level.objectCount; i++)
+      children[i] = makeObject(ecs, level.object(i));
+
+    switch (level.overlay) {
+    case LevelOverlay::Tutorial:
+      ecs.entity()
+          .emplace<Position>(0, 0)
+          .add<render::Image, assets::Tutorial>()
+          .add<render::Depth, render::Depth::Background>();
+      break;
+    case LevelOverlay::EndingScreen:
+      ecs.entity()
+          .emplace<Position>(0, 0)
+          .add<render::Image, assets::EndingScreen>()
+          .add<render::Depth, render::Depth::Background>();
+      break;
+    default:
+      break;
+    }
+  });
+  for (int i = 0; i < level.linkCount; i++) {
+    auto link = level.link(i);
+    children[link.from].add<ConnectedTo>(children[link.to]);
+  }
+
+  compileCircuit(e);
+  return e;
+}
+
+// Moves the player to the start of a room instance
+void placePlayer(flecs::world ecs, flecs::entity room) {
+  ecs.entity<Player>()
+      .set<Position>({18 * 16, 7 * 16})
+      .set<GridPosition>({PLAYER_START_X, PLAYER_START_Y})
+      .set<GridPosition, Previous>({-1, -1})
+      .set<RoomSlot>({})
+      .remove<Holding>(flecs::Wildcard)
+      .child_of(room);
+}
+
+bool setLevelPack(flecs::world &ecs, const uint8_t *data, size_t size) {
+  LevelPack pack;
+  if (!pack.view.open(data, size))
+    return false;
+  pack.prefabs.resize(pack.view.room_count());
+  ecs.set<LevelPack>(std::move(pack));
+  ecs.set<ChangeRoom>({0});
+  return true;
+}
+
+flecs::entity loadRoom(flecs::world &ecs, int index) {
+  // Prefabs are built and compiled straight away even when asked for from a
+  // system, so their children exist for compileCircuit
+  bool deferred = ecs.is_deferred();
+  if (deferred)
+    ecs.defer_suspend();
+
+  flecs::entity room;
+  auto pack = ecs.get_mut<LevelPack>();
+  LevelView level;
+  if (!pack || index < 0 || index >= (int)pack->prefabs.size()) {
+    printf("No room %d in the level pack\n", index);
+  } else if (pack->prefabs[index]) {
+    room = ecs.entity(pack->prefabs[index]);
+  } else if (!pack->view.room(index, level)) {
+    printf("Room %d of the level pack is corrupt\n", index);
+  } else {
+    room = makeRoom(ecs, index, level);
+    // Components registered while making the room can move the pack
+    ecs.get_mut<LevelPack>()->prefabs[index] = room;
+  }
+
+  if (deferred)
+    ecs.defer_resume();
+  return room;
+}
+
 void initRoom(flecs::world &ecs) {
   ecs.component<RoomObjects>().add(EcsAlwaysOverride);
+  ecs.component<RoomSlot>().member<uint16_t>("index");
   ecs.component<Room>().add_second<RoomObjects>(flecs::With);
-  ecs.component<NextRoom>().add(flecs::Exclusive);
-  ecs.component<ChangeRoom>().add(flecs::Exclusive);
-
-  auto grass = ecs.id<ld53::assets::Tileset::Grass>();
-  auto grassTall = ecs.id<ld53::assets::Tileset::GrassTall>();
-  auto top = ecs.id<ld53::assets::Tileset::TreeTop>();
-  auto bottom = ecs.id<ld53::assets::Tileset::TreeBottom>();
-  auto both = ecs.id<ld53::assets::Tileset::TreeBoth>();
-  auto wall = ecs.id<ld53::assets::Tileset::Wall>();
-  auto wallBottom = ecs.id<ld53::assets::Tileset::WallBottom>();
-  auto wireTR = ecs.id<ld53::assets::Tileset::WireTR>();
-  auto wireLR = ecs.id<ld53::assets::Tileset::WireLR>();
-  auto wireTB = ecs.id<ld53::assets::Tileset::WireTB>();
-  auto wireTL = ecs.id<ld53::assets::Tileset::WireTL>();
-  auto wireBR = ecs.id<ld53::assets::Tileset::WireBR>();
-  std::unordered_map<char, flecs::entity_t> tiles{
-      {' ', grass},      {'v', top},    {'#', both},   {'^', bottom},
-      {'B', wallBottom}, {'W', wall},   {'L', wireTR}, {'-', wireLR},
-      {'|', wireTB},     {'/', wireTL}, {'=', wireBR}, {'@', grassTall}};
+  ecs.component<PackRoom>()
+      .member<uint16_t>("index")
+      .member<uint16_t>("next");
+  ecs.component<ChangeRoom>().member<uint16_t>("room");
+  ecs.component<LevelPack>();
+  ecs.entity<Rooms>();
 
   ecs.prefab<Prefab::Mailbox>()
       .add<render::Image, assets::Tileset::Mailbox>()
       // TODO: Work out why this is needed?
       .override<render::Image, assets::Tileset::Mailbox>()
       .add<MailBox>()
-      .add(TileType::SolidPlayer);
+      .add(TileType::SolidPlayer)
+      .add<render::Depth, render::Depth::Fixture>()
+      .override<render::Depth, render::Depth::Fixture>();
   ecs.prefab<Prefab::Mail>()
       .add<MailObject>()
       .add<render::Image, assets::Tileset::Mail>()
       // TODO: Work out why this is needed?
       .override<render::Image, assets::Tileset::Mail>()
-      .add<Weighted>();
+      .add<Weighted>()
+      .add<render::Depth, render::Depth::Movable>()
+      .override<render::Depth, render::Depth::Movable>();
   ecs.prefab<Prefab::Box>()
       .add<render::Image, assets::Tileset::Box>()
       // TODO: Work out why this is needed?
@@ -104,342 +221,140 @@ void initRoom(flecs::world &ecs) {
   ecs.prefab<Prefab::Gate>()
       .add<render::Image, assets::Tileset::Gate>()
       .add<Gate>()
-      .add(TileType::Solid);
+      .add(TileType::Solid)
+      .add<render::Depth, render::Depth::Fixture>()
+      .override<render::Depth, render::Depth::Fixture>();
   ecs.prefab<Prefab::GateInverted>()
-      .add<render::Image, assets::Tileset::Gate>()
+      .add<render::Image, assets::Tileset::GateOpened>()
       .add<Gate>()
       .add<Inverted>()
-      .add(TileType::Solid);
+      .add(TileType::None)
+      .add<render::Depth, render::Depth::Fixture>()
+      .override<render::Depth, render::Depth::Fixture>();
   ecs.prefab<Prefab::ButtonPlate>()
       .add<render::Image, assets::Tileset::ButtonPlate>()
       .add<WeightActivated>()
       .add<render::Depth, render::Depth::Background>()
       .override<render::Depth, render::Depth::Background>();
 
-  makeRoom<Rooms::EndingScreen>(ecs,
-                                "#^^^^^^^^^^^^^^^^^^#"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#                  #"
-                                "#vvvvvvvvvvvvvvvvvv#",
-                                tiles)
-      .with(flecs::ChildOf, [&]() {
-        ecs.entity()
-            .emplace<Position>(0, 0)
-            .add<render::Image, assets::EndingScreen>()
-            .add<render::Depth, render::Depth::Background>();
-      });
-  makeRoom<Rooms::Level5>(ecs,
-                          "#^^^^^^^^^^^^^^^^^^#"
-                          "#    W     WWWWWWWW#"
-                          "#    W     BBBBBBBB#"
-                          "#    W     @       #"
-                          "#    W     WWW@WWWW#"
-                          "#@@ @B     WBB@BBBB#"
-                          "#          W  @    #"
-                          "#          B       #"
-                          "#          WWWWWWWW#"
-                          "#WWW W     WBBBBBBB#"
-                          "#BBB W     W       #"
-                          "#    W     W       #"
-                          "#    W     W       #"
-                          "#    W     B       #"
-                          "#vvvvBvvvvvvvvvvvvv#",
-                          tiles)
-      .with(
-          flecs::ChildOf,
-          [&]() {
-            ecs.entity().emplace<GridPosition>(18, 13).is_a<Prefab::Mailbox>();
-            ecs.entity().emplace<GridPosition>(18, 5).is_a<Prefab::Mail>();
-
-            auto gate1 =
-                ecs.entity().emplace<GridPosition>(14, 7).is_a<Prefab::Gate>();
-            auto gate3 =
-                ecs.entity().emplace<GridPosition>(14, 2).is_a<Prefab::Gate>();
-            auto gate4 =
-                ecs.entity().emplace<GridPosition>(11, 2).is_a<Prefab::Gate>();
-            auto gate5 =
-                ecs.entity().emplace<GridPosition>(11, 13).is_a<Prefab::Gate>();
-
-            auto gateMail1 =
-                ecs.entity().emplace<GridPosition>(14, 3).is_a<Prefab::Gate>();
-            auto gateMail2 =
-                ecs.entity().emplace<GridPosition>(15, 3).is_a<Prefab::Gate>();
-
-            auto gate6 =
-                ecs.entity().emplace<GridPosition>(3, 5).is_a<Prefab::Gate>();
-            auto gate7 =
-                ecs.entity().emplace<GridPosition>(4, 9).is_a<Prefab::Gate>();
-
-            ecs.entity().emplace<GridPosition>(8, 7).is_a<Prefab::Box>();
-            ecs.entity().emplace<GridPosition>(2, 11).is_a<Prefab::Box>();
-            ecs.entity().emplace<GridPosition>(2, 12).is_a<Prefab::Box>();
+  ecs.component<RoomSnapshot>();
 
-            ecs.entity()
-                .emplace<GridPosition>(12, 6)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate1);
-            ecs.entity()
-                .emplace<GridPosition>(18, 2)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate3)
-                .add<ConnectedTo>(gate4)
-                .add<ConnectedTo>(gate5);
-            ecs.entity()
-                .emplace<GridPosition>(18, 3)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate3)
-                .add<ConnectedTo>(gate4)
-                .add<ConnectedTo>(gate5);
-            ecs.entity()
-                .emplace<GridPosition>(2, 1)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate6)
-                .add<ConnectedTo>(gateMail1);
-            ecs.entity()
-                .emplace<GridPosition>(2, 7)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate7);
-
-            ecs.entity()
-                .emplace<GridPosition>(6, 13)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gateMail2);
-          })
-      .add<NextRoom, Rooms::EndingScreen>();
-  makeRoom<Rooms::Level4>(ecs,
-                          "#^^^^^^^^^^^^^^^^^^#"
-                          "#                  #"
-                          "#    W             #"
-                          "#    W             #"
-                          "#W WWW@@@@@@@@@@@@@#"
-                          "#B BBW             #"
-                          "#    W             #"
-                          "#    W             #"
-                          "#    W             #"
-                          "#    B             #"
-                          "#    W             #"
-                          "#    W             #"
-                          "#WWWWWWWWWWWWW     #"
-                          "#BBBBBBBBBBBBB     #"
-                          "#vvvvvvvvvvvvvvvvvv#",
-                          tiles)
-      .with(
-          flecs::ChildOf,
-          [&]() {
-            ecs.entity().emplace<GridPosition>(1, 13).is_a<Prefab::Mailbox>();
-            ecs.entity().emplace<GridPosition>(17, 1).is_a<Prefab::Mail>();
-            ecs.entity().emplace<GridPosition>(17, 2).is_a<Prefab::Mail>();
-            ecs.entity().emplace<GridPosition>(17, 3).is_a<Prefab::Mail>();
-
-            ecs.entity().emplace<GridPosition>(17, 6).is_a<Prefab::Box>();
-            ecs.entity().emplace<GridPosition>(17, 8).is_a<Prefab::Box>();
-
-            auto gate1 =
-                ecs.entity().emplace<GridPosition>(2, 4).is_a<Prefab::Gate>();
-            auto gate2 = ecs.entity()
-                             .emplace<GridPosition>(5, 9)
-                             .is_a<Prefab::Gate>()
-                             .add<Inverted>();
-
-            ecs.entity()
-                .emplace<GridPosition>(2, 9)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate1)
-                .add<ConnectedTo>(gate2);
-
-            auto gateExit1 =
-                ecs.entity().emplace<GridPosition>(7, 13).is_a<Prefab::Gate>();
-            auto gateExit2 =
-                ecs.entity().emplace<GridPosition>(9, 13).is_a<Prefab::Gate>();
-            auto gateExit3 =
-                ecs.entity().emplace<GridPosition>(11, 13).is_a<Prefab::Gate>();
-            auto gateExit4 =
-                ecs.entity().emplace<GridPosition>(13, 13).is_a<Prefab::Gate>();
-
-            ecs.entity()
-                .emplace<GridPosition>(7, 8)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gateExit1);
-            ecs.entity()
-                .emplace<GridPosition>(9, 8)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gateExit2);
-            ecs.entity()
-                .emplace<GridPosition>(11, 8)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gateExit3);
-            ecs.entity()
-                .emplace<GridPosition>(13, 8)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gateExit4);
-          })
-      .add<NextRoom, Rooms::Level5>();
-  makeRoom<Rooms::Level3>(ecs,
-                          "#^^^^^^^^^^^^^^^^^^#"
-                          "#                  #"
-                          "#   WWW   WWW      #"
-                          "#   WBW =-WBW      #"
-                          "#   W W | W W      #"
-                          "#   W W | W W      #"
-                          "#   B B | B B      #"
-                          "#    L--/  |       #"
-                          "#          |       #"
-                          "#                  #"
-                          "#                  #"
-                          "#                  #"
-                          "#                  #"
-                          "#                  #"
-                          "#vvvvvvvvvvvvvvvvvv#",
-                          tiles)
-      .with(
-          flecs::ChildOf,
-          [&]() {
-            ecs.entity().emplace<GridPosition>(10, 9).is_a<Prefab::Mail>();
-            ecs.entity().emplace<GridPosition>(5, 3).is_a<Prefab::Mailbox>();
-            ecs.entity().emplace<GridPosition>(14, 8).is_a<Prefab::Box>();
-            auto gate1 =
-                ecs.entity().emplace<GridPosition>(5, 6).is_a<Prefab::Gate>();
-            auto gate2 =
-                ecs.entity().emplace<GridPosition>(11, 6).is_a<Prefab::Gate>();
-            ecs.entity()
-                .emplace<GridPosition>(11, 9)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate2);
-            ecs.entity()
-                .emplace<GridPosition>(11, 3)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate1);
-          })
-      .add<NextRoom, Rooms::Level4>();
-  makeRoom<Rooms::Level2>(ecs,
-                          "#^^^^^^^^^^^^^^^^^^#"
-                          "#        WW        #"
-                          "#        BB        #"
-                          "#                  #"
-                          "#        WW        #"
-                          "#        BBW       #"
-                          "#     =----WWWW WWW#"
-                          "#     |  @@BBBB BBB#"
-                          "#  W -/  @@        #"
-                          "#  W     @@        #"
-                          "#  W     @@        #"
-                          "#  W     @@WW      #"
-                          "#  B     @@BW      #"
-                          "#        @@ W      #"
-                          "#vvvvvvvvvvvBvvvvvv#",
-                          tiles)
-      .with(
-          flecs::ChildOf,
-          [&]() {
-            ecs.entity().emplace<GridPosition>(11, 13).is_a<Prefab::Mailbox>();
-            ecs.entity().emplace<GridPosition>(3, 3).is_a<Prefab::Mailbox>();
-            ecs.entity().emplace<GridPosition>(14, 3).is_a<Prefab::Mail>();
-            ecs.entity().emplace<GridPosition>(14, 8).is_a<Prefab::Mail>();
-
-            auto gate1 =
-                ecs.entity().emplace<GridPosition>(15, 6).is_a<Prefab::Gate>();
-            auto gate2 =
-                ecs.entity().emplace<GridPosition>(10, 3).is_a<Prefab::Gate>();
-            auto gate3 =
-                ecs.entity().emplace<GridPosition>(10, 2).is_a<Prefab::Gate>();
-
-            ecs.entity()
-                .emplace<GridPosition>(4, 8)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate1);
-            ecs.entity()
-                .emplace<GridPosition>(4, 10)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate2)
-                .add<ConnectedTo>(gate3);
-          })
-      .add<NextRoom, Rooms::Level3>();
-
-  makeRoom<Rooms::Level1>(ecs,
-                          "#^^^^^^^^^^^^^^^^^^#"
-                          "#                  #"
-                          "#   WWWWWWWWW      #"
-                          "#   WBBBBBBBW      #"
-                          "#   W       W      #"
-                          "#   WWWWWWW W      #"
-                          "#   BBBBBBB|B      #"
-                          "#@@@@@@   =/       #"
-                          "#@@@ @@   |        #"
-                          "#@@@@@@            #"
-                          "#                  #"
-                          "#                  #"
-                          "#                  #"
-                          "#                  #"
-                          "#vvvvvvvvvvvvvvvvvv#",
-                          tiles)
-      .with(
-          flecs::ChildOf,
-          [&]() {
-            ecs.entity().emplace<GridPosition>(5, 4).is_a<Prefab::Mail>();
-            ecs.entity().emplace<GridPosition>(4, 8).is_a<Prefab::Mailbox>();
+  // Runs after the circuit is bound and before the player's input is handled
+  // so nothing has moved yet
+  ecs.system<const RoomObjects, const Circuit *>("snapshotRoom")
+      .kind(flecs::PreUpdate)
+      .with<Room>()
+      .without<RoomSnapshot>()
+      .each([](flecs::entity e, const RoomObjects &objects,
+               const Circuit *circuit) {
+        auto snapshot = e.get_mut<RoomSnapshot>();
+        snapshot->objects = objects;
+        if (circuit)
+          snapshot->circuit = *circuit;
+        snapshot->count = 0;
+        auto player = e.world().entity<Player>();
+        e.children([&](flecs::entity child) {
+          auto grid = child.get<GridPosition>();
+          if (!grid || child == player)
+            return;
+          if (snapshot->count == MAX_ROOM_OBJECTS) {
+            printf("Too many objects to snapshot in %s\n", e.path().c_str());
+            return;
+          }
+          auto type = child.get<TileType>();
+          child.set<UndoIndex>({snapshot->count});
+          auto &entry = snapshot->entries[snapshot->count++];
+          entry.entity = child;
+          entry.image = child.target<render::Image>();
+          entry.grid = *grid;
+          entry.type = type ? *type : TileType::None;
+          entry.hasType = type != nullptr;
+          entry.full = child.has<MailBox::Full>();
+          entry.pressed = child.has<WeightActivated::Pressed>();
+        });
+      });
 
-            ecs.entity().emplace<GridPosition>(11, 9).is_a<Prefab::Box>();
-            auto gate1 =
-                ecs.entity().emplace<GridPosition>(11, 5).is_a<Prefab::Gate>();
-            ecs.entity()
-                .emplace<GridPosition>(10, 9)
-                .is_a<Prefab::ButtonPlate>()
-                .add<ConnectedTo>(gate1);
+  // Puts every object back where the snapshot has it with no slot, the same
+  // as a fresh instance, so the usual systems add them to the room map again
+  ecs.system<const RoomSnapshot, RoomObjects, Circuit *, UndoLog *>(
+         "restoreRoom")
+      .with<RoomSnapshot::Restore>()
+      .write<GridPosition>()
+      .write<GridPosition, Previous>()
+      .write<RoomSlot>()
+      .each([](flecs::entity e, const RoomSnapshot &snapshot,
+               RoomObjects &objects, Circuit *circuit, UndoLog *undo) {
+        auto ecs = e.world();
+        e.remove<RoomSnapshot::Restore>();
+        objects = snapshot.objects;
+        if (circuit)
+          *circuit = snapshot.circuit;
+        if (undo)
+          undo->clear();
 
-            ecs.entity()
-                .emplace<Position>(0, 0)
-                .add<render::Image, assets::Tutorial>()
-                .add<render::Depth, render::Depth::Background>();
-          })
-      .add<NextRoom, Rooms::Level2>();
+        for (int i = 0; i < snapshot.count; i++) {
+          auto &entry = snapshot.entries[i];
+          auto child = ecs.entity(entry.entity);
+          child.enable();
+          child.remove<Velocity>()
+              .remove<AtRest>()
+              .set<GridPosition>(entry.grid)
+              .set<GridPosition, Previous>({-1, -1})
+              .set<Position>({entry.grid.x * 16, entry.grid.y * 16})
+              .set<RoomSlot>({});
+          if (entry.image)
+            child.add<render::Image>(entry.image);
+          if (entry.hasType)
+            child.add(entry.type);
+          if (entry.full)
+            child.add<MailBox::Full>();
+          else
+            child.remove<MailBox::Full>();
+          if (entry.pressed)
+            child.add<WeightActivated::Pressed>();
+          else
+            child.remove<WeightActivated::Pressed>();
+          if (child.has<Gate>())
+            child.add<Gate::Dirty>();
+        }
+        placePlayer(ecs, e);
+      });
 
-  ecs.system<>("changeOnComplete")
+  // Cached once rather than building a filter every tick
+  auto unfilled = ecs.query_builder<>()
+                      .with<MailBox>()
+                      .without<MailBox::Full>()
+                      .not_()
+                      .build();
+  ecs.system<const PackRoom>("changeOnComplete")
       .with<Room>()
-      .with<NextRoom>(flecs::Wildcard)
-      .each([](flecs::entity e) {
-        auto numToFill = e.world()
-                             .filter_builder<>()
-                             .with<MailBox>()
-                             .without<MailBox::Full>()
-                             .not_()
-                             .build()
-                             .count();
+      .each([unfilled](flecs::entity e, const PackRoom &room) {
+        if (room.next == NO_ROOM)
+          return;
+        auto numToFill = unfilled.count();
         if (numToFill != 0)
           return;
-        e.world().add<ChangeRoom>(e.target<NextRoom>());
+        e.world().set<ChangeRoom>({room.next});
       });
 
-  ecs.system<>("changeRoom")
-      .with<ChangeRoom>(flecs::Wildcard)
-      .each([](flecs::entity e) {
+  ecs.system<const ChangeRoom>("changeRoom")
+      .each([](flecs::entity e, const ChangeRoom &change) {
         auto ecs = e.world();
-        auto nextRoom = e.target<ChangeRoom>();
-        e.remove<ChangeRoom>(flecs::Wildcard);
+        auto index = change.room;
+        e.remove<ChangeRoom>();
+        auto nextRoom = loadRoom(ecs, index);
+        if (!nextRoom)
+          return;
         ecs.add<CurrentRoomType>(nextRoom);
 
         auto room = ecs.entity().is_a(nextRoom).child_of<RoomInstances>();
         auto prev = ecs.singleton<CurrentRoom>().target<CurrentRoom>();
         ecs.add<CurrentRoom>(room);
 
-        e.world()
-            .entity<Player>()
-            .set<Position>({18 * 16, 7 * 16})
-            .set<GridPosition>({16, 7})
-            .set<GridPosition, Previous>({-1, -1})
-            .child_of(room);
+        placePlayer(ecs, room);
 
-        prev.destruct();
+        if (prev)
+          prev.destruct();
       });
 }
 } // namespace ld53::game
@@ -1,9 +1,16 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <cstdint>
 #include <flecs.h>
+#include <type_traits>
 #include <vector>
 
+#include "circuit.h"
+#include "common.h"
+#include "pack.h"
+
 namespace ld53::game {
 
 constexpr int ROOM_WIDTH = 20;
@@ -21,38 +28,242 @@ struct Room {
   }
 };
 
+constexpr int ROOM_CELLS = ROOM_WIDTH * ROOM_HEIGHT;
+// Where the player is placed on entering a room
+constexpr int PLAYER_START_X = 16;
+constexpr int PLAYER_START_Y = 7;
+constexpr int MAX_ROOM_OBJECTS = 1024;
+constexpr uint16_t NO_SLOT = 0xFFFF;
+static_assert(MAX_PACK_OBJECTS < MAX_ROOM_OBJECTS,
+              "every object in a pack room needs a slot next to the player");
+
+// Spatial index of the objects in a room. Every object owns one pooled slot
+// which is linked into a list per cell, so insert/remove/move are O(1) and
+// nothing allocates. It is trivially copyable so instancing a room prefab is
+// a single memcpy.
+//
+// It also tracks which cells block movement. Each cell counts the solid tiles
+// and objects in it and the bitmaps are flipped when a count moves between
+// zero and one, so checking a cell is a single bit test. Weighted objects
+// are counted the same way for pressure plates.
 struct RoomObjects {
-  // I'm not even going to pretend this is a good way of doing this
-  std::array<std::vector<flecs::entity_t>, ROOM_WIDTH * ROOM_HEIGHT> objects{};
+  struct Slot {
+    flecs::entity_t entity;
+    uint16_t next, prev;
+    uint16_t cell;
+    TileType type;
+    bool weighted;
+  };
+  using Bits = std::array<uint64_t, (ROOM_CELLS + 63) / 64>;
+
+  std::array<uint16_t, ROOM_CELLS> heads;
+  std::array<Slot, MAX_ROOM_OBJECTS> slots{};
+  uint16_t freeList{NO_SLOT};
+  uint16_t used{0};
+
+  std::array<uint8_t, ROOM_CELLS> solidCount{};
+  std::array<uint8_t, ROOM_CELLS> solidPlayerCount{};
+  Bits solid{};
+  Bits solidPlayer{};
+  std::array<uint8_t, ROOM_CELLS> weightCount{};
+
+  RoomObjects() { heads.fill(NO_SLOT); }
+
+  class Iterator {
+    const RoomObjects *objs;
+    uint16_t slot;
+
+  public:
+    Iterator(const RoomObjects *objs, uint16_t slot) : objs(objs), slot(slot) {}
+    const flecs::entity_t &operator*() const {
+      return objs->slots[slot].entity;
+    }
+    Iterator &operator++() {
+      slot = objs->slots[slot].next;
+      return *this;
+    }
+    bool operator!=(const Iterator &o) const { return slot != o.slot; }
+  };
+  struct Range {
+    const RoomObjects *objs;
+    uint16_t head;
+    Iterator begin() const { return {objs, head}; }
+    Iterator end() const { return {objs, NO_SLOT}; }
+    bool empty() const { return head == NO_SLOT; }
+  };
+
+  Range get_objects(int x, int y) const {
+    assert(x >= 0 && x < ROOM_WIDTH);
+    assert(y >= 0 && y < ROOM_HEIGHT);
+    return {this, heads[x + y * ROOM_WIDTH]};
+  }
 
-  const std::vector<flecs::entity_t> &get_objects(int x, int y) const {
+  bool is_solid(int x, int y, bool isPlayer) const {
     assert(x >= 0 && x < ROOM_WIDTH);
     assert(y >= 0 && y < ROOM_HEIGHT);
-    return objects[x + y * ROOM_WIDTH];
+    int cell = x + y * ROOM_WIDTH;
+    uint64_t bit = uint64_t(1) << (cell & 63);
+    return (solid[cell >> 6] & bit) ||
+           (isPlayer && (solidPlayer[cell >> 6] & bit));
   }
-  std::vector<flecs::entity_t> &get_objects(int x, int y) {
+
+  bool is_weighted(int x, int y) const {
     assert(x >= 0 && x < ROOM_WIDTH);
     assert(y >= 0 && y < ROOM_HEIGHT);
-    return objects[x + y * ROOM_WIDTH];
+    return weightCount[x + y * ROOM_WIDTH] != 0;
+  }
+
+  // Static tiles are counted once when the room is made
+  void add_tile(int x, int y, TileType type) {
+    count(x + y * ROOM_WIDTH, type, 1);
+  }
+
+  uint16_t insert(int x, int y, flecs::entity_t entity,
+                  TileType type = TileType::None, bool weighted = false) {
+    uint16_t slot = freeList;
+    if (slot != NO_SLOT) {
+      freeList = slots[slot].next;
+    } else {
+      assert(used < MAX_ROOM_OBJECTS);
+      if (used == MAX_ROOM_OBJECTS)
+        return NO_SLOT;
+      slot = used++;
+    }
+    slots[slot].entity = entity;
+    slots[slot].type = type;
+    slots[slot].weighted = weighted;
+    link(slot, x + y * ROOM_WIDTH);
+    return slot;
+  }
+  void remove(uint16_t slot) {
+    unlink(slot);
+    slots[slot].entity = 0;
+    slots[slot].type = TileType::None;
+    slots[slot].weighted = false;
+    slots[slot].next = freeList;
+    freeList = slot;
+  }
+  void move(uint16_t slot, int x, int y) {
+    unlink(slot);
+    link(slot, x + y * ROOM_WIDTH);
+  }
+  void set_type(uint16_t slot, TileType type) {
+    auto &s = slots[slot];
+    if (s.type == type)
+      return;
+    count(s.cell, s.type, -1);
+    s.type = type;
+    count(s.cell, s.type, 1);
+  }
+
+private:
+  void count(int cell, TileType type, int delta) {
+    uint8_t *counts;
+    Bits *bits;
+    switch (type) {
+    case TileType::Solid:
+      counts = &solidCount[cell];
+      bits = &solid;
+      break;
+    case TileType::SolidPlayer:
+      counts = &solidPlayerCount[cell];
+      bits = &solidPlayer;
+      break;
+    default:
+      return;
+    }
+    *counts += delta;
+    uint64_t bit = uint64_t(1) << (cell & 63);
+    if (*counts)
+      (*bits)[cell >> 6] |= bit;
+    else
+      (*bits)[cell >> 6] &= ~bit;
+  }
+
+  void link(uint16_t slot, int cell) {
+    assert(cell >= 0 && cell < ROOM_CELLS);
+    auto &s = slots[slot];
+    s.cell = cell;
+    s.prev = NO_SLOT;
+    s.next = heads[cell];
+    if (s.next != NO_SLOT)
+      slots[s.next].prev = slot;
+    heads[cell] = slot;
+    count(cell, s.type, 1);
+    weightCount[cell] += s.weighted;
+  }
+  void unlink(uint16_t slot) {
+    auto &s = slots[slot];
+    count(s.cell, s.type, -1);
+    weightCount[s.cell] -= s.weighted;
+    if (s.prev != NO_SLOT)
+      slots[s.prev].next = s.next;
+    else
+      heads[s.cell] = s.next;
+    if (s.next != NO_SLOT)
+      slots[s.next].prev = s.prev;
   }
 };
 
-struct Rooms {
-  struct Level1 {};
-  struct Level2 {};
-  struct Level3 {};
-  struct Level4 {};
-  struct Level5 {};
-  struct EndingScreen {};
+// Slot an object holds in its room's RoomObjects
+struct RoomSlot {
+  uint16_t index{NO_SLOT};
+};
+
+// A room instance as it was before anything in it moved, taken the first
+// frame its children exist. Restarting copies it back over the instance in
+// place instead of making a new one.
+struct RoomSnapshot {
+  // Added to the current room instance to restart it
+  struct Restore {};
+
+  struct Object {
+    flecs::entity_t entity;
+    flecs::entity_t image;
+    GridPosition grid;
+    TileType type;
+    bool hasType;
+    bool full;
+    bool pressed;
+  };
+
+  RoomObjects objects;
+  Circuit circuit;
+  std::array<Object, MAX_ROOM_OBJECTS> entries;
+  uint16_t count{0};
+};
+static_assert(std::is_trivially_copyable_v<RoomSnapshot>);
+
+// Scope the room prefabs are named under
+struct Rooms {};
+
+// Where a room prefab came from in the level pack and the room after it
+struct PackRoom {
+  uint16_t index{0};
+  uint16_t next{NO_ROOM};
+};
+
+// The pack rooms are read from, with the prefab of each room once it has
+// been needed. The bytes belong to the platform and outlive the world.
+struct LevelPack {
+  LevelPackView view;
+  std::vector<flecs::entity_t> prefabs;
 };
-using InitialRoom = Rooms::Level1;
 
 struct RoomInstances {};
 struct CurrentRoomType {};
 struct CurrentRoom {};
 
-struct NextRoom {};
-struct ChangeRoom {};
+// Switches to a room of the level pack, by its index
+struct ChangeRoom {
+  uint16_t room;
+};
+
+// Opens a level pack and starts its first room
+bool setLevelPack(flecs::world &ecs, const uint8_t *data, size_t size);
+// Prefab for a room of the pack, made from the pack the first time it is
+// asked for
+flecs::entity loadRoom(flecs::world &ecs, int index);
 
 void initRoom(flecs::world &ecs);
 } // namespace ld53::game
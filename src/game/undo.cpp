@@ -0,0 +1,231 @@
+#include "undo.h"
+#include "assets.h"
+#include "common.h"
+#include "player.h"
+#include "render/render.h"
+
+namespace ld53::game {
+
+namespace {
+
+flecs::entity objectEntity(flecs::world &ecs, const RoomSnapshot &snapshot,
+                           uint16_t object) {
+  if (object == UNDO_PLAYER)
+    return ecs.entity<Player>();
+  return ecs.entity(snapshot.entries[object].entity);
+}
+
+UndoLog::Tracked track(flecs::entity e, flecs::entity held) {
+  auto grid = e.get<GridPosition>();
+  uint8_t flags = 0;
+  if (e.has(flecs::Disabled))
+    flags |= UndoLog::Disabled;
+  if (e.has<MailBox::Full>())
+    flags |= UndoLog::Full;
+  if (e.has<WeightActivated::Pressed>())
+    flags |= UndoLog::Pressed;
+  if (e == held)
+    flags |= UndoLog::Held;
+  return {(uint16_t)(grid->x + grid->y * ROOM_WIDTH), flags};
+}
+
+// Puts an object back to a tracked state, moving its slot directly so
+// nothing has to be validated or pushed again
+void apply(flecs::entity e, flecs::entity player, RoomObjects &objects,
+           const UndoLog::Tracked &state) {
+  int x = state.cell % ROOM_WIDTH;
+  int y = state.cell / ROOM_WIDTH;
+  auto slot = e.get<RoomSlot>();
+  uint16_t index = slot ? slot->index : NO_SLOT;
+  GridPosition prev{x, y};
+  if (state.flags & UndoLog::Disabled) {
+    if (index != NO_SLOT)
+      objects.remove(index);
+    index = NO_SLOT;
+    prev = {-1, -1};
+    e.disable();
+  } else {
+    if (index == NO_SLOT) {
+      auto ty = e.get<TileType>();
+      index = objects.insert(x, y, e, ty ? *ty : TileType::None,
+                             e.has<Weighted>());
+    } else {
+      objects.move(index, x, y);
+    }
+    e.enable();
+  }
+  e.remove<Velocity>()
+      .remove<AtRest>()
+      .set<GridPosition>({x, y})
+      .set<GridPosition, Previous>(prev)
+      .set<Position>({x * 16, y * 16})
+      .set<RoomSlot>({index});
+
+  if (e.has<MailBox>()) {
+    if (state.flags & UndoLog::Full)
+      e.add<MailBox::Full>()
+          .add<render::Image, assets::Tileset::MailboxFull>();
+    else
+      e.remove<MailBox::Full>()
+          .add<render::Image, assets::Tileset::Mailbox>();
+  }
+  if (e.has<WeightActivated>()) {
+    if (state.flags & UndoLog::Pressed)
+      e.add<WeightActivated::Pressed>()
+          .add<render::Image, assets::Tileset::ButtonPlatePressed>();
+    else
+      e.remove<WeightActivated::Pressed>()
+          .add<render::Image, assets::Tileset::ButtonPlate>();
+  }
+  if (state.flags & UndoLog::Held)
+    player.add<Holding>(e);
+  else if (player.has<Holding>(e))
+    player.remove<Holding>(e);
+}
+
+} // namespace
+
+void touchUndo(flecs::entity object, bool circuit) {
+  auto index = object.get<UndoIndex>();
+  if (!index)
+    return;
+  // Through a ref, get_mut while deferred would only change a copy
+  auto log = object.parent().get_ref<UndoLog>().get();
+  if (!log)
+    return;
+  log->touch(index->index);
+  log->circuitDirty |= circuit;
+}
+
+void initUndo(flecs::world &ecs) {
+  ecs.component<UndoLog>();
+  ecs.component<UndoIndex>().member<uint16_t>("index");
+
+  ecs.system<>("addUndoLog")
+      .kind(flecs::PostUpdate)
+      .with<RoomSnapshot>()
+      .without<UndoLog>()
+      .each([](flecs::entity e) { e.add<UndoLog>(); });
+
+  // After resolveMovement so blocked moves have already been put back. Only
+  // the player, the objects touched since the last record and, once an input
+  // flipped, the circuit are compared, so a quiet room costs next to nothing.
+  ecs.system<UndoLog, const RoomSnapshot, const Circuit *>("recordUndo")
+      .kind(flecs::PostUpdate)
+      .each([](flecs::entity e, UndoLog &log, const RoomSnapshot &snapshot,
+               const Circuit *circuit) {
+        auto ecs = e.world();
+        auto player = ecs.entity<Player>();
+        auto held = player.target<Holding>();
+        auto playerState = track(player, held);
+
+        if (!log.synced) {
+          log.tracked[UNDO_PLAYER] = playerState;
+          for (uint16_t i = 0; i < snapshot.count; i++)
+            log.tracked[i] = track(objectEntity(ecs, snapshot, i), held);
+          if (circuit) {
+            for (int i = 0; i < circuit->nodeCount; i++)
+              log.nodes[i] = circuit->value(i);
+          }
+          log.isDirty.fill(false);
+          log.dirtyCount = 0;
+          log.circuitDirty = false;
+          log.held = held;
+          log.synced = true;
+          return;
+        }
+
+        // Throwing lets go of something without moving
+        bool step = playerState.cell != log.tracked[UNDO_PLAYER].cell ||
+                    (log.held && log.held != held);
+        log.held = held;
+        bool marked = step || !log.count;
+        if (marked)
+          log.push({UndoLog::Kind::Step, 0, 0});
+        bool changed = false;
+
+        auto record = [&](uint16_t object, const UndoLog::Tracked &now) {
+          auto &was = log.tracked[object];
+          if (now.cell != was.cell)
+            log.push({UndoLog::Kind::Cell, object, was.cell});
+          if (now.flags != was.flags)
+            log.push({UndoLog::Kind::Flags, object, was.flags});
+          changed |= now.cell != was.cell || now.flags != was.flags;
+          was = now;
+        };
+        record(UNDO_PLAYER, playerState);
+        for (uint16_t i = 0; i < log.dirtyCount; i++) {
+          auto object = log.dirty[i];
+          log.isDirty[object] = false;
+          record(object, track(objectEntity(ecs, snapshot, object), held));
+        }
+        log.dirtyCount = 0;
+        if (circuit && log.circuitDirty) {
+          for (uint16_t i = 0; i < circuit->nodeCount; i++) {
+            if (circuit->value(i) == log.nodes[i])
+              continue;
+            log.push({UndoLog::Kind::Node, i, log.nodes[i]});
+            log.nodes[i] = circuit->value(i);
+            changed = true;
+          }
+        }
+        log.circuitDirty = false;
+
+        // Nothing happened, so the marker pushed for it is taken back
+        if (marked && !changed) {
+          UndoLog::Change marker;
+          log.pop(marker);
+        }
+      });
+
+  // Pops changes back to the last step marker, only touching what they name
+  ecs.system<UndoLog, const RoomSnapshot, RoomObjects, Circuit *>("undoStep")
+      .with<UndoLog::Undo>()
+      .write<GridPosition>()
+      .write<GridPosition, Previous>()
+      .write<RoomSlot>()
+      .write<Position>()
+      .each([](flecs::entity e, UndoLog &log, const RoomSnapshot &snapshot,
+               RoomObjects &objects, Circuit *circuit) {
+        auto ecs = e.world();
+        e.remove<UndoLog::Undo>();
+        if (!log.synced)
+          return;
+
+        std::array<bool, MAX_ROOM_OBJECTS + 1> touched{};
+        UndoLog::Change change;
+        while (log.pop(change) && change.kind != UndoLog::Kind::Step) {
+          switch (change.kind) {
+          case UndoLog::Kind::Cell:
+            log.tracked[change.target].cell = change.value;
+            touched[change.target] = true;
+            break;
+          case UndoLog::Kind::Flags:
+            log.tracked[change.target].flags = (uint8_t)change.value;
+            touched[change.target] = true;
+            break;
+          case UndoLog::Kind::Node:
+            log.nodes[change.target] = change.value != 0;
+            if (circuit) {
+              circuit->nodes[change.target].value = change.value != 0;
+              auto gate = circuit->entities[change.target];
+              if (gate && ecs.entity(gate).has<Gate>())
+                ecs.entity(gate).add<Gate::Dirty>();
+            }
+            break;
+          case UndoLog::Kind::Step:
+            break;
+          }
+        }
+
+        auto player = ecs.entity<Player>();
+        if (touched[UNDO_PLAYER])
+          apply(player, player, objects, log.tracked[UNDO_PLAYER]);
+        for (uint16_t i = 0; i < snapshot.count; i++) {
+          if (touched[i])
+            apply(objectEntity(ecs, snapshot, i), player, objects,
+                  log.tracked[i]);
+        }
+      });
+}
+} // namespace ld53::game
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <flecs.h>
+
+#include "circuit.h"
+#include "room.h"
+
+namespace ld53::game {
+
+constexpr uint32_t UNDO_LOG_SIZE = 16384;
+// Object index the player is tracked under, snapshot entries use the rest
+constexpr uint16_t UNDO_PLAYER = MAX_ROOM_OBJECTS;
+
+// An object's index in its room's RoomSnapshot, its changes are logged
+// under it
+struct UndoIndex {
+  uint16_t index;
+};
+
+// History of a room instance as the changes each step made, newest last. A
+// step starts when the player moves to a new cell or throws, and collects
+// everything that changes until the next one. Only what changed is stored,
+// objects by their index in the RoomSnapshot, so a step is a few bytes. The
+// log is a fixed ring, once full the oldest steps are dropped so long
+// sessions never allocate.
+struct UndoLog {
+  // Added to the current room instance to undo its last step
+  struct Undo {};
+
+  enum Flags : uint8_t {
+    Disabled = 1 << 0,
+    Full = 1 << 1,
+    Pressed = 1 << 2,
+    // Carried by the player
+    Held = 1 << 3,
+  };
+
+  enum class Kind : uint8_t {
+    Step,
+    Cell,
+    Flags,
+    Node,
+  };
+
+  // The value `target` had before the change
+  struct Change {
+    Kind kind;
+    uint16_t target;
+    uint16_t value;
+  };
+
+  struct Tracked {
+    uint16_t cell;
+    uint8_t flags;
+  };
+
+  std::array<Change, UNDO_LOG_SIZE> changes;
+  uint32_t head{0};
+  uint32_t count{0};
+  // State as of the last record, changes are found by comparing against it
+  std::array<Tracked, MAX_ROOM_OBJECTS + 1> tracked;
+  std::array<bool, MAX_CIRCUIT_NODES> nodes;
+  // Objects touched since the last record, the only ones compared. The
+  // player is always compared.
+  std::array<uint16_t, MAX_ROOM_OBJECTS> dirty;
+  std::array<bool, MAX_ROOM_OBJECTS> isDirty{};
+  uint16_t dirtyCount{0};
+  // A circuit input flipped since the last record
+  bool circuitDirty{false};
+  // What the player held at the last record
+  flecs::entity_t held{0};
+  // Cleared to take the room's state again without logging it
+  bool synced{false};
+
+  void push(const Change &change) {
+    if (count == UNDO_LOG_SIZE) {
+      // Drop the oldest step whole so undo never stops part way into one
+      do {
+        count--;
+      } while (count && changes[(head - count) % UNDO_LOG_SIZE].kind !=
+                            Kind::Step);
+    }
+    changes[head] = change;
+    head = (head + 1) % UNDO_LOG_SIZE;
+    count++;
+  }
+
+  void touch(uint16_t object) {
+    if (isDirty[object])
+      return;
+    isDirty[object] = true;
+    dirty[dirtyCount++] = object;
+  }
+
+  bool pop(Change &change) {
+    if (!count)
+      return false;
+    head = (head + UNDO_LOG_SIZE - 1) % UNDO_LOG_SIZE;
+    count--;
+    change = changes[head];
+    return true;
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+    synced = false;
+  }
+};
+
+// Marks an object whose cell or flags changed this tick so the next record
+// compares it, `circuit` when it also flipped a circuit input. Anything that
+// changes what undo tracks has to call it.
+void touchUndo(flecs::entity object, bool circuit = false);
+
+void initUndo(flecs::world &ecs);
+} // namespace ld53::game
@@ -0,0 +1,45 @@
+#include "input.h"
+#include "loop.h"
+
+namespace ld53::input {
+
+InputQueue &inputQueue() {
+  static InputQueue queue;
+  return queue;
+}
+
+bool nextInput(flecs::world ecs, InputEvent &event) {
+  if (!inputQueue().pop(event))
+    return false;
+  if (ecs.has<InputRecording>()) {
+    auto frame = currentTick(ecs);
+    // Appended in place, get_mut would copy the whole log into the deferred
+    // command queue on every input
+    ecs.get_ref<InputRecording>()->log.inputs.push_back({frame, event.data});
+  }
+  return true;
+}
+
+void startRecording(flecs::world &ecs, uint32_t seed) {
+  InputRecording recording;
+  recording.log.seed = seed;
+  recording.log.inputs.reserve(4096);
+  ecs.set<InputRecording>(std::move(recording));
+}
+
+void initInput(flecs::world &ecs) {
+  flecs::enum_type<InputType>(ecs);
+  ecs.component<InputType>()
+      .constant("Up", (int32_t)InputType::Up)
+      .constant("Down", (int32_t)InputType::Down)
+      .constant("Left", (int32_t)InputType::Left)
+      .constant("Right", (int32_t)InputType::Right)
+      .constant("Fire", (int32_t)InputType::Fire)
+      .constant("Restart", (int32_t)InputType::Restart)
+      .constant("Undo", (int32_t)InputType::Undo);
+  ecs.component<InputData>().member<bool>("pressed").member<InputType>("type");
+  ecs.component<InputRecording>();
+
+  initInputBackend(ecs);
+}
+} // namespace ld53::input
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <flecs.h>
+
+#include "queue.h"
+#include "record.h"
+
+namespace ld53::input {
+
+// Present while the session's inputs are being recorded
+struct InputRecording {
+  InputLog log;
+};
+
+// Queue the platform backend feeds and processPlayerInput drains
+InputQueue &inputQueue();
+// Pops the next queued event, logging it against the current frame when
+// recording
+bool nextInput(flecs::world ecs, InputEvent &event);
+
+void startRecording(flecs::world &ecs, uint32_t seed);
+
+void initInput(flecs::world &ecs);
+// Implemented by the platform (web/native) backend
+void initInputBackend(flecs::world &ecs);
+} // namespace ld53::input
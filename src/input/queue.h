@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ld53::input {
+
+enum class InputType {
+  Up,
+  Down,
+  Left,
+  Right,
+  Fire,
+  Restart,
+  Undo,
+};
+
+struct InputData {
+  bool pressed;
+  InputType type;
+};
+
+// A key event as handed over by the platform, `time` is in milliseconds on
+// the platform's own clock
+struct InputEvent {
+  uint32_t time;
+  InputData data;
+};
+
+constexpr uint32_t INPUT_QUEUE_SIZE = 64;
+static_assert((INPUT_QUEUE_SIZE & (INPUT_QUEUE_SIZE - 1)) == 0);
+
+// Fixed size single producer/single consumer ring. The platform pushes from
+// its event callbacks and the game drains it once per frame, neither side
+// allocates or blocks. Events are dropped when the ring is full.
+class InputQueue {
+  std::array<InputEvent, INPUT_QUEUE_SIZE> events{};
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+
+public:
+  bool push(const InputEvent &event) {
+    auto t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE)
+      return false;
+    events[t & (INPUT_QUEUE_SIZE - 1)] = event;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(InputEvent &event) {
+    auto h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+    event = events[h & (INPUT_QUEUE_SIZE - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_relaxed) ==
+           tail.load(std::memory_order_acquire);
+  }
+};
+
+} // namespace ld53::input
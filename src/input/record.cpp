@@ -0,0 +1,95 @@
+#include "record.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace ld53::input {
+
+namespace {
+
+constexpr uint8_t MAGIC[4] = {'L', 'D', '5', '3'};
+constexpr size_t HEADER_SIZE = 4 + 4 + 4 + 4 + 8 + 4;
+constexpr size_t RECORD_SIZE = 4 + 1 + 1;
+
+void put(std::vector<uint8_t> &out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+uint64_t get(const uint8_t *data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value |= (uint64_t)data[i] << (i * 8);
+  return value;
+}
+
+} // namespace
+
+std::vector<uint8_t> encodeInputLog(const InputLog &log) {
+  std::vector<uint8_t> out;
+  out.reserve(HEADER_SIZE + log.inputs.size() * RECORD_SIZE);
+  out.insert(out.end(), MAGIC, MAGIC + 4);
+  put(out, INPUT_LOG_VERSION, 4);
+  put(out, log.seed, 4);
+  put(out, log.frames, 4);
+  put(out, log.hash, 8);
+  put(out, log.inputs.size(), 4);
+  for (auto &input : log.inputs) {
+    put(out, input.frame, 4);
+    put(out, (uint8_t)input.data.type, 1);
+    put(out, input.data.pressed, 1);
+  }
+  return out;
+}
+
+bool decodeInputLog(const uint8_t *data, size_t size, InputLog &out) {
+  if (size < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0)
+    return false;
+  if (get(data + 4, 4) != INPUT_LOG_VERSION) {
+    printf("Unsupported input log version %u\n", (uint32_t)get(data + 4, 4));
+    return false;
+  }
+  out.seed = (uint32_t)get(data + 8, 4);
+  out.frames = (uint32_t)get(data + 12, 4);
+  out.hash = get(data + 16, 8);
+  auto count = get(data + 24, 4);
+  if (size - HEADER_SIZE < count * RECORD_SIZE)
+    return false;
+
+  out.inputs.resize(count);
+  auto record = data + HEADER_SIZE;
+  for (auto &input : out.inputs) {
+    input.frame = (uint32_t)get(record, 4);
+    if (record[4] > (uint8_t)InputType::Undo)
+      return false;
+    input.data.type = (InputType)record[4];
+    input.data.pressed = record[5] != 0;
+    record += RECORD_SIZE;
+  }
+  return true;
+}
+
+bool writeInputLog(const char *path, const InputLog &log) {
+  auto file = fopen(path, "wb");
+  if (!file)
+    return false;
+  auto data = encodeInputLog(log);
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+  return ok;
+}
+
+bool readInputLog(const char *path, InputLog &out) {
+  auto file = fopen(path, "rb");
+  if (!file)
+    return false;
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t read;
+  while ((read = fread(buf, 1, sizeof(buf), file)) > 0)
+    data.insert(data.end(), buf, buf + read);
+  fclose(file);
+  return decodeInputLog(data.data(), data.size(), out);
+}
+
+} // namespace ld53::input
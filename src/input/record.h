@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "queue.h"
+
+namespace ld53::input {
+
+constexpr uint32_t INPUT_LOG_VERSION = 1;
+
+struct LoggedInput {
+  uint32_t frame;
+  InputData data;
+};
+
+// Everything needed to replay a session: the seed rand() was started with,
+// the inputs by the frame they were consumed on, and how long the session ran
+// along with the game state hash at the end of it.
+struct InputLog {
+  uint32_t seed{0};
+  uint32_t frames{0};
+  uint64_t hash{0};
+  std::vector<LoggedInput> inputs;
+};
+
+// Little endian: "LD53", version, seed, frames, hash, count, then count
+// records of u32 frame, u8 type, u8 pressed
+std::vector<uint8_t> encodeInputLog(const InputLog &log);
+bool decodeInputLog(const uint8_t *data, size_t size, InputLog &out);
+
+bool writeInputLog(const char *path, const InputLog &log);
+bool readInputLog(const char *path, InputLog &out);
+
+} // namespace ld53::input
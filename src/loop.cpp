@@ -0,0 +1,108 @@
+#include "loop.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+#include "input/input.h"
+#include "profile/profile.h"
+#include "profile/trace.h"
+
+namespace ld53 {
+
+namespace {
+
+flecs::entity_t buildPipeline(flecs::world &ecs,
+                              std::initializer_list<flecs::entity_t> phases) {
+  // Same as the default pipeline but limited to systems directly in `phases`
+  auto builder = ecs.pipeline();
+  builder.with(flecs::System)
+      .with(flecs::Phase)
+      .cascade(flecs::DependsOn)
+      .without(flecs::Disabled)
+      .up(flecs::DependsOn)
+      .without(flecs::Disabled)
+      .up(flecs::ChildOf);
+  size_t i = 0;
+  for (auto phase : phases) {
+    builder.with(flecs::DependsOn, phase);
+    if (++i < phases.size())
+      builder.or_();
+  }
+  return builder.build().id();
+}
+
+} // namespace
+
+void initLoop(flecs::world &ecs) {
+  ecs.component<FrameClock>()
+      .member<double>("accumulator")
+      .member<uint32_t>("tick")
+      .member<float>("alpha")
+      .member<uint32_t>("lastWake");
+
+  FrameClock clock;
+  clock.simulation = buildPipeline(
+      ecs, {flecs::OnLoad, flecs::PostLoad, flecs::PreUpdate, flecs::OnUpdate,
+            flecs::OnValidate, flecs::PostUpdate});
+  clock.presentation =
+      buildPipeline(ecs, {flecs::PreFrame, flecs::PreStore, flecs::OnStore,
+                          flecs::PostFrame});
+  ecs.set<FrameClock>(clock);
+}
+
+uint32_t currentTick(const flecs::world &ecs) {
+  auto clock = ecs.get<FrameClock>();
+  return clock ? clock->tick : 0;
+}
+
+void simulate(flecs::world &ecs) {
+  auto start = profile::now();
+  ecs.set_pipeline(ecs.entity(ecs.get<FrameClock>()->simulation));
+  ecs.progress(TICK_SECONDS);
+  ecs.get_mut<FrameClock>()->tick++;
+  profile::traceProgress(profile::TraceEvent::Kind::Tick, start);
+}
+
+void present(flecs::world &ecs, float alpha, float delta) {
+  auto clock = ecs.get_mut<FrameClock>();
+  clock->alpha = alpha;
+  clock->sincePresent = 0;
+  // Animated tiles bring this forward as they are drawn
+  clock->untilAnimation = std::numeric_limits<double>::infinity();
+  auto start = profile::now();
+  ecs.set_pipeline(ecs.entity(clock->presentation));
+  ecs.progress(delta);
+  profile::traceProgress(profile::TraceEvent::Kind::Present, start);
+}
+
+void wake(flecs::world &ecs) { ecs.get_mut<FrameClock>()->wake(); }
+
+int advance(flecs::world &ecs, double now) {
+  profile::beginFrame();
+  auto clock = ecs.get_mut<FrameClock>();
+  double elapsed = clock->last < 0 ? TICK_SECONDS : now - clock->last;
+  elapsed = std::clamp(elapsed, 0.0, MAX_FRAME_SECONDS);
+  clock->last = now;
+  clock->accumulator += elapsed;
+  clock->sincePresent += elapsed;
+  // Input is checked before it is drained so the ticks handling it are
+  // always shown
+  if (!input::inputQueue().empty())
+    clock->wake();
+
+  int ticks = 0;
+  while (ecs.get<FrameClock>()->accumulator >= TICK_SECONDS) {
+    simulate(ecs);
+    ecs.get_mut<FrameClock>()->accumulator -= TICK_SECONDS;
+    ticks++;
+  }
+  // Frames are only ever drawn once however many ticks were caught up on
+  auto done = ecs.get<FrameClock>();
+  if (!done->idle() || done->sincePresent >= done->untilAnimation) {
+    present(ecs, (float)(done->accumulator / TICK_SECONDS),
+            (float)done->sincePresent);
+  }
+  profile::endFrame(ticks);
+  return ticks;
+}
+} // namespace ld53
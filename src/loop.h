@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <flecs.h>
+
+namespace ld53 {
+
+// Gameplay always advances in ticks of this length, movement is counted in
+// ticks so it plays at the same speed whatever rate frames are shown at
+constexpr float TICK_SECONDS = 1.0f / 60.0f;
+// Longest stretch of real time a single frame catches up on, past this (a
+// hidden tab, a debugger pause) the game slows down instead of stalling
+constexpr double MAX_FRAME_SECONDS = 0.25;
+// Ticks after the last change to how the game looks that frames are still
+// drawn for, covering changes that only show up a tick or two later
+constexpr uint32_t IDLE_TICKS = 4;
+
+// The game phases (OnLoad to PostUpdate) run in the simulation pipeline once
+// per tick, the render phases (PreFrame and PreStore onwards) in the
+// presentation pipeline once per shown frame. Once nothing on screen changes
+// frames stop being drawn, the canvas keeps showing the last one.
+struct FrameClock {
+  flecs::entity_t simulation{0};
+  flecs::entity_t presentation{0};
+  // Real time not yet simulated
+  double accumulator{0};
+  double last{-1};
+  uint32_t tick{0};
+  // How far the shown frame is between the last two ticks
+  float alpha{1};
+  // Tick anything last happened that changes how the game looks
+  uint32_t lastWake{0};
+  // Real time since the last shown frame, and from it until an animated tile
+  // is due its next frame
+  double sincePresent{0};
+  double untilAnimation{std::numeric_limits<double>::infinity()};
+
+  void wake() { lastWake = tick; }
+  bool idle() const { return tick - lastWake > IDLE_TICKS; }
+};
+
+void initLoop(flecs::world &ecs);
+// Ticks run so far, input logs are timed by these
+uint32_t currentTick(const flecs::world &ecs);
+void simulate(flecs::world &ecs);
+void present(flecs::world &ecs, float alpha, float delta);
+// Keeps frames being drawn, for changes from outside the game systems
+void wake(flecs::world &ecs);
+// Runs as many ticks as have passed by `now` (seconds) then shows one frame
+// unless the world is idle. Returns the ticks run.
+int advance(flecs::world &ecs, double now);
+} // namespace ld53
@@ -1,7 +1,7 @@
 #pragma once
 
-#include <emscripten/val.h>
 #include <flecs.h>
+#include <string>
 
 extern flecs::world *gWorld;
 
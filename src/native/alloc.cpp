@@ -0,0 +1,25 @@
+// Replaces the global operator new so the allocation counter sees the
+// game's own containers too. Linked into the native executables only, the
+// solver allocates from several threads and isn't counted.
+#include <cstdlib>
+#include <new>
+
+#include "profile/alloc.h"
+
+void *operator new(std::size_t size) {
+  ld53::profile::countAllocation(size);
+  if (auto ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  ld53::profile::countAllocation(size);
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <flecs.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "assets.h"
+#include "game/common.h"
+#include "game/pack.h"
+#include "game/room.h"
+#include "input/input.h"
+#include "loop.h"
+#include "profile/profile.h"
+#include "render/commands.h"
+#include "render/render.h"
+
+using namespace ld53;
+
+namespace {
+
+// Objects per generated room, the rest go in further instances
+constexpr int OBJECTS_PER_ROOM = 1000;
+// Plates and the gates they open per room, kept inside a room's circuit
+constexpr int PAIRS_PER_ROOM = 60;
+constexpr int SIZES[] = {10, 100, 1000, 10000};
+// Each system is run at least this many times and for at least this long
+constexpr int MIN_RUNS = 10;
+constexpr uint64_t MIN_NS = 20'000'000;
+
+// One room of `count` objects: a plate and gate pair for every ten (up to
+// PAIRS_PER_ROOM), mail and a mailbox for every ten, boxes for the rest. They
+// are spread over the floor so big rooms hold several per cell.
+game::LevelDef generateRoom(int count) {
+  game::LevelDef def;
+  def.name = "Bench";
+  // Leads back to itself so changeOnComplete has somewhere to go
+  def.next = 0;
+  for (int y = 0; y < game::MAP_HEIGHT; y++) {
+    for (int x = 0; x < game::MAP_WIDTH; x++) {
+      bool edge = x == 0 || y == 0 || x == game::MAP_WIDTH - 1 ||
+                  y == game::MAP_HEIGHT - 1;
+      def.tiles[x + y * game::MAP_WIDTH] =
+          edge ? game::TileId::Wall : game::TileId::Grass;
+    }
+  }
+
+  int floor = (game::MAP_WIDTH - 2) * (game::MAP_HEIGHT - 2);
+  auto add = [&](game::LevelObject kind) {
+    int cell = (int)def.objects.size() % floor;
+    def.objects.push_back({(uint8_t)(1 + cell % (game::MAP_WIDTH - 2)),
+                           (uint8_t)(1 + cell / (game::MAP_WIDTH - 2)),
+                           kind});
+    return (uint16_t)(def.objects.size() - 1);
+  };
+  int pairs = std::min(count / 10, PAIRS_PER_ROOM);
+  for (int i = 0; i < pairs; i++) {
+    auto plate = add(game::LevelObject::ButtonPlate);
+    auto gate = add(game::LevelObject::Gate);
+    def.links.push_back({plate, gate});
+  }
+  for (int i = 0; i < count / 10; i++) {
+    add(game::LevelObject::Mail);
+    add(game::LevelObject::Mailbox);
+  }
+  while ((int)def.objects.size() < count)
+    add(game::LevelObject::Box);
+  return def;
+}
+
+struct Result {
+  int objects;
+  std::string system;
+  uint64_t runNs;
+  double objectNs;
+};
+
+struct Bench {
+  const char *system;
+  // Run before every timed run, outside of the timing
+  std::function<void(flecs::world &)> setup;
+};
+
+// Steps every object one cell from where it was last committed and wakes it,
+// so the movement systems have work to do on every run
+void stepObjects(flecs::world &ecs, int &direction) {
+  direction = -direction;
+  ecs.defer([&]() {
+    ecs.filter_builder<game::GridPosition, const game::GridPosition>()
+        .term_at(2)
+        .second<game::Previous>()
+        .with<game::RoomSlot>()
+        .build()
+        .each([&](flecs::entity e, game::GridPosition &pos,
+                  const game::GridPosition &prev) {
+          pos.x = prev.x + direction;
+          pos.y = prev.y;
+          e.remove<game::AtRest>();
+        });
+  });
+}
+
+void clearDraws(flecs::world &ecs) {
+  ecs.get_mut<render::DrawCommands>()->clear();
+}
+
+std::vector<Result> runSize(int objects) {
+  flecs::world ecs;
+  initLoop(ecs);
+  assets::loadAssets(ecs);
+  render::initRender(ecs);
+  game::initGame(ecs);
+  input::initInput(ecs);
+
+  // Every image counts as loaded, the null backend only records handles
+  ecs.defer([&]() {
+    ecs.each([](flecs::entity e, render::ImageAsset &) {
+      e.add<render::ImageAsset::IsLoaded>();
+    });
+  });
+
+  int rooms = (objects + OBJECTS_PER_ROOM - 1) / OBJECTS_PER_ROOM;
+  auto pack = game::encodeLevelPack({generateRoom(objects / rooms)});
+  if (!game::setLevelPack(ecs, pack.data(), pack.size())) {
+    printf("Generated level pack is invalid\n");
+    exit(1);
+  }
+  // Instances are made here rather than by changing room
+  ecs.remove<game::ChangeRoom>();
+  auto prefab = game::loadRoom(ecs, 0);
+  for (int i = 0; i < rooms; i++)
+    ecs.entity().is_a(prefab).child_of<game::RoomInstances>();
+  // Boxes push whatever is in the cell they step into
+  ecs.defer([&]() {
+    ecs.filter_builder().with<game::Pushable>().build().each(
+        [](flecs::entity e) { e.add<game::CanPush>(); });
+  });
+
+  // Settle into the room map, then draw once so everything has a drawn
+  // position
+  for (int i = 0; i < 4; i++)
+    simulate(ecs);
+  present(ecs, 1.0f, TICK_SECONDS);
+
+  int direction = 1;
+  auto step = [&](flecs::world &w) { stepObjects(w, direction); };
+  std::vector<Bench> benches = {
+      {"resolveMovement", step},
+      {"activateOnWeight", nullptr},
+      {"updateWorldPosition", nullptr},
+      {"changeOnComplete", nullptr},
+      {"interpolatePosition", nullptr},
+      {"drawRoom", clearDraws},
+      {"drawSprites", clearDraws},
+  };
+
+  std::vector<Result> results;
+  std::vector<uint64_t> times;
+  for (auto &bench : benches) {
+    auto e = ecs.lookup(bench.system);
+    if (!e) {
+      printf("No system %s\n", bench.system);
+      continue;
+    }
+    flecs::system system(ecs, e);
+    times.clear();
+    uint64_t total = 0;
+    while ((int)times.size() < MIN_RUNS || total < MIN_NS) {
+      if (bench.setup)
+        bench.setup(ecs);
+      auto start = profile::now();
+      system.run(TICK_SECONDS);
+      auto elapsed = profile::now() - start;
+      times.push_back(elapsed);
+      total += elapsed;
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                     times.end());
+    auto median = times[times.size() / 2];
+    results.push_back(
+        {objects, bench.system, median, (double)median / objects});
+  }
+  return results;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *json = nullptr;
+  std::vector<int> sizes(std::begin(SIZES), std::end(SIZES));
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+      json = argv[++i];
+    } else if (!strcmp(argv[i], "--objects") && i + 1 < argc) {
+      sizes = {atoi(argv[++i])};
+    } else {
+      printf("Usage: %s [--objects N] [--json results.json]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  printf("%8s  %-24s %12s %12s\n", "objects", "system", "ns/run",
+         "ns/object");
+  for (auto objects : sizes) {
+    if (objects <= 0)
+      continue;
+    for (auto &result : runSize(objects)) {
+      printf("%8d  %-24s %12llu %12.2f\n", result.objects,
+             result.system.c_str(), (unsigned long long)result.runNs,
+             result.objectNs);
+      results.push_back(result);
+    }
+  }
+
+  if (json) {
+    auto file = fopen(json, "w");
+    if (!file) {
+      printf("Failed to open %s\n", json);
+      return 1;
+    }
+    // One result per line so runs from two commits diff cleanly
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+      auto &result = results[i];
+      fprintf(file,
+              "  {\"objects\": %d, \"system\": \"%s\", \"ns_per_run\": %llu, "
+              "\"ns_per_object\": %.3f}%s\n",
+              result.objects, result.system.c_str(),
+              (unsigned long long)result.runNs, result.objectNs,
+              i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+#include "data.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game/room.h"
+#include "main.h"
+
+namespace ld53 {
+std::string locateFile(const char *path) {
+  static const char *dataDir = getenv("LD53_DATA");
+  return std::string(dataDir ? dataDir : "./data/") + path;
+}
+} // namespace ld53
+
+namespace ld53::game {
+
+bool mapLevelPack(flecs::world &ecs) {
+  auto path = locateFile("levels.pack");
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("Failed to open %s\n", path.c_str());
+    return false;
+  }
+  struct stat info;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    printf("Failed to map %s\n", path.c_str());
+    return false;
+  }
+  if (!setLevelPack(ecs, (const uint8_t *)data, info.st_size)) {
+    printf("%s is not a level pack\n", path.c_str());
+    munmap(data, info.st_size);
+    return false;
+  }
+  return true;
+}
+
+} // namespace ld53::game
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <flecs.h>
+
+namespace ld53::game {
+// Maps the level pack from the data directory and hands it to the game, the
+// mapping is kept for the life of the process
+bool mapLevelPack(flecs::world &ecs);
+} // namespace ld53::game
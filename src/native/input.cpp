@@ -0,0 +1,96 @@
+#include "input.h"
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include "loop.h"
+
+namespace ld53::input {
+
+std::optional<InputType> mapName(std::string_view name) {
+  if (name == "Up")
+    return InputType::Up;
+  if (name == "Down")
+    return InputType::Down;
+  if (name == "Left")
+    return InputType::Left;
+  if (name == "Right")
+    return InputType::Right;
+  if (name == "Fire")
+    return InputType::Fire;
+  if (name == "Restart")
+    return InputType::Restart;
+  if (name == "Undo")
+    return InputType::Undo;
+  return {};
+}
+
+bool loadInputScript(flecs::world &ecs, const char *path) {
+  std::ifstream file{path};
+  if (!file) {
+    printf("Failed to open input script %s\n", path);
+    return false;
+  }
+
+  InputScript script;
+  int64_t frame;
+  std::string action;
+  while (file >> frame >> action) {
+    auto type = action.size() > 1 ? mapName(std::string_view{action}.substr(1))
+                                  : std::nullopt;
+    if (!type || (action[0] != '+' && action[0] != '-')) {
+      printf("Bad input script action '%s'\n", action.c_str());
+      return false;
+    }
+    script.events.push_back({frame, {action[0] == '+', *type}});
+  }
+  std::stable_sort(
+      script.events.begin(), script.events.end(),
+      [](const auto &a, const auto &b) { return a.frame < b.frame; });
+
+  ecs.set<InputScript>(std::move(script));
+  return true;
+}
+
+void playInputLog(flecs::world &ecs, const InputLog &log) {
+  InputScript script;
+  script.events.reserve(log.inputs.size());
+  for (auto &input : log.inputs)
+    script.events.push_back({input.frame, input.data});
+  ecs.set<InputScript>(std::move(script));
+}
+
+void playWalkScript(flecs::world &ecs, int64_t frames) {
+  constexpr int64_t HOLD = 30;
+  InputScript script;
+  for (int64_t frame = 0; frame < frames; frame += HOLD) {
+    auto type = (frame / HOLD) % 2 ? InputType::Right : InputType::Left;
+    script.events.push_back({frame, {true, type}});
+    script.events.push_back({frame + HOLD - 1, {false, type}});
+  }
+  ecs.set<InputScript>(std::move(script));
+}
+
+void initInputBackend(flecs::world &ecs) {
+  ecs.component<InputScript>();
+
+  ecs.system<InputScript>("playInputScript")
+      .kind(flecs::OnLoad)
+      .term_at(1)
+      .singleton()
+      .iter([](flecs::iter &it, InputScript *script) {
+        auto frame = currentTick(it.world());
+        auto &queue = inputQueue();
+        while (script->next < script->events.size() &&
+               script->events[script->next].frame <= frame) {
+          auto &event = script->events[script->next];
+          // Frames are a fixed 60Hz so the timestamp is derived from them
+          if (!queue.push({(uint32_t)(event.frame * 1000 / 60), event.data}))
+            break;
+          script->next++;
+        }
+      });
+}
+} // namespace ld53::input
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <flecs.h>
+#include <vector>
+
+#include "input/input.h"
+#include "input/record.h"
+
+namespace ld53::input {
+
+struct ScriptedInput {
+  int64_t frame;
+  InputData data;
+};
+
+// Input events replayed at fixed frame numbers in place of a keyboard
+struct InputScript {
+  std::vector<ScriptedInput> events;
+  size_t next{0};
+};
+
+// Loads a script of `<frame> <+|-><Up|Down|Left|Right|Fire|Restart|Undo>` lines
+bool loadInputScript(flecs::world &ecs, const char *path);
+// Replays a recorded session's inputs on the frames they were consumed on
+void playInputLog(flecs::world &ecs, const InputLog &log);
+// Holds left then right in turn for `frames`, walking the player back and
+// forth over the same cells
+void playWalkScript(flecs::world &ecs, int64_t frames);
+} // namespace ld53::input
@@ -0,0 +1,183 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <flecs.h>
+#include <string>
+
+#include "assets.h"
+#include "game/common.h"
+#include "input/input.h"
+#include "native/input.h"
+#include "input/record.h"
+#include "loop.h"
+#include "native/data.h"
+#include "native/render.h"
+#include "profile/alloc.h"
+#include "profile/profile.h"
+#include "profile/trace.h"
+#include "render/render.h"
+
+flecs::world *gWorld = nullptr;
+
+// Frames left for tables, command queues and logs to reach their steady size
+// before --check-alloc starts failing on allocations
+constexpr int ALLOC_WARMUP_FRAMES = 120;
+
+// Lists the systems that allocated in the newest profiled frame
+void printAllocations() {
+  auto &p = ld53::profile::profiler();
+  auto slot = p.slot(0);
+  auto row = p.allocRow(slot);
+  printf("Frame %llu allocated %u times\n", (unsigned long long)(p.frames - 1),
+         p.frameAllocs[slot]);
+  for (size_t i = 0; i < p.systems.size(); i++) {
+    if (row[i])
+      printf("  %-28s %u\n", p.systems[i].name.c_str(), row[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  int frames = 600;
+  const char *script = nullptr;
+  const char *drawLog = nullptr;
+  const char *png = nullptr;
+  int scale = 1;
+  uint32_t seed = 1;
+  const char *record = nullptr;
+  const char *replay = nullptr;
+  const char *profile = nullptr;
+  const char *trace = nullptr;
+  bool checkAlloc = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--input") && i + 1 < argc) {
+      script = argv[++i];
+    } else if (!strcmp(argv[i], "--draw-log") && i + 1 < argc) {
+      drawLog = argv[++i];
+    } else if (!strcmp(argv[i], "--png") && i + 1 < argc) {
+      png = argv[++i];
+    } else if (!strcmp(argv[i], "--scale") && i + 1 < argc) {
+      scale = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      record = argv[++i];
+    } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replay = argv[++i];
+    } else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+      profile = argv[++i];
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace = argv[++i];
+    } else if (!strcmp(argv[i], "--check-alloc")) {
+      checkAlloc = true;
+    } else {
+      printf("Usage: %s [--frames N] [--seed N] [--input script.txt] "
+             "[--record session.bin | --replay session.bin] "
+             "[--draw-log draws.txt] [--png frame.png [--scale N]] "
+             "[--profile frames.csv|frames.json] [--trace trace.json] "
+             "[--check-alloc]\n",
+             argv[0]);
+      return 1;
+    }
+  }
+
+  ld53::input::InputLog log;
+  if (replay) {
+    if (!ld53::input::readInputLog(replay, log)) {
+      printf("Failed to read input log %s\n", replay);
+      return 1;
+    }
+    seed = log.seed;
+    frames = (int)log.frames;
+  }
+  // Nothing draws from rand() since maps are baked at compile time, it is
+  // still seeded and recorded so replays hold if that changes
+  srand(seed);
+
+  ld53::profile::countFlecsAllocations();
+  gWorld = new flecs::world{argc, argv};
+  ld53::initLoop(*gWorld);
+
+  ld53::assets::loadAssets(*gWorld);
+  ld53::render::initRender(*gWorld);
+  ld53::game::initGame(*gWorld);
+  ld53::input::initInput(*gWorld);
+  if (!ld53::game::mapLevelPack(*gWorld))
+    return 1;
+
+  if (script && !ld53::input::loadInputScript(*gWorld, script))
+    return 1;
+  if (record)
+    ld53::input::startRecording(*gWorld, seed);
+  if (replay)
+    ld53::input::playInputLog(*gWorld, log);
+  else if (checkAlloc && !script)
+    ld53::input::playWalkScript(*gWorld, frames);
+  // Only the simulation is needed unless the frames are being looked at
+  bool draw = !replay || drawLog || png;
+  if (drawLog && !ld53::render::openDrawLog(*gWorld, drawLog))
+    return 1;
+  if (png)
+    ld53::render::enableSoftwareRender(*gWorld);
+  // Tracing records system spans and allocations are checked per system
+  // through the profiler's wrapper
+  if (profile || trace || checkAlloc)
+    ld53::profile::installProfiler(*gWorld);
+  if (trace)
+    ld53::profile::startTrace(*gWorld);
+
+  // Every tick is shown whole so runs are repeatable regardless of host speed
+  auto &profiler = ld53::profile::profiler();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frames; i++) {
+    ld53::profile::beginFrame();
+    ld53::simulate(*gWorld);
+    if (draw)
+      ld53::present(*gWorld, 1.0f, ld53::TICK_SECONDS);
+    ld53::profile::endFrame(1);
+    if (checkAlloc && i >= ALLOC_WARMUP_FRAMES &&
+        profiler.frameAllocs[profiler.slot(0)]) {
+      printAllocations();
+      return 1;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  printf("%d frames in %.3fms (%.0f ticks/s)\n", frames,
+         elapsed.count() * 1000.0, frames / elapsed.count());
+
+  auto hash = ld53::game::hashGameState(*gWorld);
+  printf("State hash %016llx\n", (unsigned long long)hash);
+  if (replay && hash != log.hash) {
+    printf("Replay diverged, expected %016llx\n",
+           (unsigned long long)log.hash);
+    return 1;
+  }
+  if (record) {
+    auto &recorded = gWorld->get_mut<ld53::input::InputRecording>()->log;
+    recorded.frames = (uint32_t)frames;
+    recorded.hash = hash;
+    if (!ld53::input::writeInputLog(record, recorded)) {
+      printf("Failed to write input log %s\n", record);
+      return 1;
+    }
+  }
+
+  if (profile && !ld53::profile::writeProfile(profile)) {
+    printf("Failed to write profile %s\n", profile);
+    return 1;
+  }
+  if (trace && !ld53::profile::writeTrace(*gWorld, trace)) {
+    printf("Failed to write trace %s\n", trace);
+    return 1;
+  }
+  if (png && !ld53::render::writeFrame(*gWorld, png, scale))
+    return 1;
+  if (drawLog && !ld53::render::drawLogInOrder(*gWorld))
+    return 1;
+
+  delete gWorld;
+  return 0;
+}
@@ -0,0 +1,245 @@
+#include <cstdio>
+#include <vector>
+
+#include "game/levels.h"
+#include "game/pack.h"
+
+using namespace ld53::game;
+
+namespace {
+
+constexpr RoomMap LEVEL1_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#                  #"
+    "#   WWWWWWWWW      #"
+    "#   WBBBBBBBW      #"
+    "#   W       W      #"
+    "#   WWWWWWW W      #"
+    "#   BBBBBBB|B      #"
+    "#@@@@@@   =/       #"
+    "#@@@ @@   |        #"
+    "#@@@@@@            #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#vvvvvvvvvvvvvvvvvv#",
+    1);
+constexpr RoomMap LEVEL2_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#        WW        #"
+    "#        BB        #"
+    "#                  #"
+    "#        WW        #"
+    "#        BBW       #"
+    "#     =----WWWW WWW#"
+    "#     |  @@BBBB BBB#"
+    "#  W -/  @@        #"
+    "#  W     @@        #"
+    "#  W     @@        #"
+    "#  W     @@WW      #"
+    "#  B     @@BW      #"
+    "#        @@ W      #"
+    "#vvvvvvvvvvvBvvvvvv#",
+    2);
+constexpr RoomMap LEVEL3_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#                  #"
+    "#   WWW   WWW      #"
+    "#   WBW =-WBW      #"
+    "#   W W | W W      #"
+    "#   W W | W W      #"
+    "#   B B | B B      #"
+    "#    L--/  |       #"
+    "#          |       #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#vvvvvvvvvvvvvvvvvv#",
+    3);
+constexpr RoomMap LEVEL4_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#                  #"
+    "#    W             #"
+    "#    W             #"
+    "#W WWW@@@@@@@@@@@@@#"
+    "#B BBW             #"
+    "#    W             #"
+    "#    W             #"
+    "#    W             #"
+    "#    B             #"
+    "#    W             #"
+    "#    W             #"
+    "#WWWWWWWWWWWWW     #"
+    "#BBBBBBBBBBBBB     #"
+    "#vvvvvvvvvvvvvvvvvv#",
+    4);
+constexpr RoomMap LEVEL5_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#    W     WWWWWWWW#"
+    "#    W     BBBBBBBB#"
+    "#    W     @       #"
+    "#    W     WWW@WWWW#"
+    "#@@ @B     WBB@BBBB#"
+    "#          W  @    #"
+    "#          B       #"
+    "#          WWWWWWWW#"
+    "#WWW W     WBBBBBBB#"
+    "#BBB W     W       #"
+    "#    W     W       #"
+    "#    W     W       #"
+    "#    W     B       #"
+    "#vvvvBvvvvvvvvvvvvv#",
+    5);
+constexpr RoomMap ENDING_SCREEN_MAP = bakeMap(
+    "#^^^^^^^^^^^^^^^^^^#"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#                  #"
+    "#vvvvvvvvvvvvvvvvvv#",
+    6);
+
+struct RoomBuilder {
+  LevelDef &def;
+
+  uint16_t add(int x, int y, LevelObject kind) {
+    def.objects.push_back({(uint8_t)x, (uint8_t)y, kind});
+    return (uint16_t)(def.objects.size() - 1);
+  }
+  // Adds a plate wired to every gate given
+  template <class... Gates> uint16_t plate(int x, int y, Gates... gates) {
+    auto plate = add(x, y, LevelObject::ButtonPlate);
+    (def.links.push_back({plate, gates}), ...);
+    return plate;
+  }
+};
+
+// Rooms are played in the order they are listed, the last is the end
+std::vector<LevelDef> buildLevels() {
+  std::vector<LevelDef> rooms;
+  auto room = [&](const char *name, const RoomMap &map,
+                  LevelOverlay overlay = LevelOverlay::None) {
+    auto &def = rooms.emplace_back();
+    def.name = name;
+    def.tiles = map;
+    def.overlay = overlay;
+    return RoomBuilder{def};
+  };
+  using enum LevelObject;
+
+  {
+    auto r = room("Level1", LEVEL1_MAP, LevelOverlay::Tutorial);
+    r.add(5, 4, Mail);
+    r.add(4, 8, Mailbox);
+    r.add(11, 9, Box);
+    auto gate1 = r.add(11, 5, Gate);
+    r.plate(10, 9, gate1);
+  }
+  {
+    auto r = room("Level2", LEVEL2_MAP);
+    r.add(11, 13, Mailbox);
+    r.add(3, 3, Mailbox);
+    r.add(14, 3, Mail);
+    r.add(14, 8, Mail);
+    auto gate1 = r.add(15, 6, Gate);
+    auto gate2 = r.add(10, 3, Gate);
+    auto gate3 = r.add(10, 2, Gate);
+    r.plate(4, 8, gate1);
+    r.plate(4, 10, gate2, gate3);
+  }
+  {
+    auto r = room("Level3", LEVEL3_MAP);
+    r.add(10, 9, Mail);
+    r.add(5, 3, Mailbox);
+    r.add(14, 8, Box);
+    auto gate1 = r.add(5, 6, Gate);
+    auto gate2 = r.add(11, 6, Gate);
+    r.plate(11, 9, gate2);
+    r.plate(11, 3, gate1);
+  }
+  {
+    auto r = room("Level4", LEVEL4_MAP);
+    r.add(1, 13, Mailbox);
+    r.add(17, 1, Mail);
+    r.add(17, 2, Mail);
+    r.add(17, 3, Mail);
+    r.add(17, 6, Box);
+    r.add(17, 8, Box);
+    auto gate1 = r.add(2, 4, Gate);
+    auto gate2 = r.add(5, 9, GateInverted);
+    r.plate(2, 9, gate1, gate2);
+    auto gateExit1 = r.add(7, 13, Gate);
+    auto gateExit2 = r.add(9, 13, Gate);
+    auto gateExit3 = r.add(11, 13, Gate);
+    auto gateExit4 = r.add(13, 13, Gate);
+    r.plate(7, 8, gateExit1);
+    r.plate(9, 8, gateExit2);
+    r.plate(11, 8, gateExit3);
+    r.plate(13, 8, gateExit4);
+  }
+  {
+    auto r = room("Level5", LEVEL5_MAP);
+    r.add(18, 13, Mailbox);
+    r.add(18, 5, Mail);
+    auto gate1 = r.add(14, 7, Gate);
+    auto gate3 = r.add(14, 2, Gate);
+    auto gate4 = r.add(11, 2, Gate);
+    auto gate5 = r.add(11, 13, Gate);
+    auto gateMail1 = r.add(14, 3, Gate);
+    auto gateMail2 = r.add(15, 3, Gate);
+    auto gate6 = r.add(3, 5, Gate);
+    auto gate7 = r.add(4, 9, Gate);
+    r.add(8, 7, Box);
+    r.add(2, 11, Box);
+    r.add(2, 12, Box);
+    r.plate(12, 6, gate1);
+    r.plate(18, 2, gate3, gate4, gate5);
+    r.plate(18, 3, gate3, gate4, gate5);
+    r.plate(2, 1, gate6, gateMail1);
+    r.plate(2, 7, gate7);
+    r.plate(6, 13, gateMail2);
+  }
+  room("EndingScreen", ENDING_SCREEN_MAP, LevelOverlay::EndingScreen);
+
+  for (size_t i = 0; i + 1 < rooms.size(); i++)
+    rooms[i].next = (uint16_t)(i + 1);
+  return rooms;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    printf("Usage: %s levels.pack\n", argv[0]);
+    return 1;
+  }
+  auto rooms = buildLevels();
+  auto data = encodeLevelPack(rooms);
+
+  auto file = fopen(argv[1], "wb");
+  if (!file) {
+    printf("Failed to open %s\n", argv[1]);
+    return 1;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+  if (!ok) {
+    printf("Failed to write %s\n", argv[1]);
+    return 1;
+  }
+  printf("Wrote %zu rooms (%zu bytes) to %s\n", rooms.size(), data.size(),
+         argv[1]);
+  return 0;
+}
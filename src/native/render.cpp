@@ -0,0 +1,178 @@
+#include "render.h"
+
+#include <cstdio>
+
+#include "game/common.h"
+#include "game/room.h"
+#include "loop.h"
+#include "main.h"
+#include "render/commands.h"
+#include "render/png.h"
+#include "render/render.h"
+#include "render/software.h"
+
+namespace ld53::render {
+
+struct NativeRenderer {
+  int32_t nextHandle{0};
+
+  // Only set when something wants the pixels, otherwise commands are
+  // recorded and dropped.
+  bool software{false};
+  std::vector<Pixels> images;
+  Pixels framebuffer;
+
+  Pixels &pixelsFor(int32_t handle) {
+    if ((size_t)handle >= images.size())
+      images.resize(handle + 1);
+    return images[handle];
+  }
+};
+
+struct DrawLog {
+  FILE *file;
+  // Frames that drew a layer under one already drawn
+  uint32_t misordered{0};
+};
+
+bool openDrawLog(flecs::world &ecs, const char *path) {
+  auto file = fopen(path, "w");
+  if (!file) {
+    printf("Failed to open draw log %s\n", path);
+    return false;
+  }
+  ecs.set<DrawLog>({file});
+  return true;
+}
+
+bool drawLogInOrder(flecs::world &ecs) {
+  auto log = ecs.get<DrawLog>();
+  return !log || !log->misordered;
+}
+
+void enableSoftwareRender(flecs::world &ecs) {
+  ecs.get_mut<NativeRenderer>()->software = true;
+}
+
+bool writeFrame(flecs::world &ecs, const char *path, int scale) {
+  auto renderer = ecs.get<NativeRenderer>();
+  Pixels scaled;
+  scaled.resize(VIRTUAL_WIDTH * scale, VIRTUAL_HEIGHT * scale);
+  upscaleNearest(renderer->framebuffer, scaled);
+  if (!writePng(path, scaled)) {
+    printf("Failed to write %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+void loadImages(flecs::entity e, NativeRenderer &renderer, ImageAsset &asset) {
+  asset.handle = renderer.nextHandle++;
+  if (renderer.software &&
+      !loadPng(locateFile(asset.path).c_str(),
+               renderer.pixelsFor(asset.handle))) {
+    printf("Failed to load %s\n", asset.path);
+  }
+  e.add<ImageAsset::IsLoaded>();
+}
+
+void buildRoom(flecs::entity e, NativeRenderer &renderer,
+               const game::Room &room) {
+  DrawCommands commands;
+  if (!bakeRoom(e.world(), room, commands))
+    return;
+
+  auto existing = e.get<RenderRoom>();
+  int32_t handle = existing ? existing->handle : renderer.nextHandle++;
+  e.set<RenderRoom>({handle});
+
+  if (renderer.software) {
+    auto &pixels = renderer.pixelsFor(handle);
+    pixels.resize(VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
+    clearPixels(pixels, 0);
+    executeCommands(pixels, commands.commands.data(),
+                    commands.commands.size(), renderer.images);
+  }
+}
+
+void renderFrame(NativeRenderer &renderer, const DrawCommands &draw) {
+  if (!renderer.software)
+    return;
+  renderer.framebuffer.resize(VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
+  clearPixels(renderer.framebuffer, 0xFF000000);
+  executeCommands(renderer.framebuffer, draw.commands.data(),
+                  draw.commands.size(), renderer.images);
+}
+
+void writeDrawLog(flecs::iter &it, DrawLog *log, const DrawCommands *draw) {
+  fprintf(log->file, "frame %u %zu\n", currentTick(it.world()),
+          draw->commands.size());
+  for (auto &cmd : draw->commands) {
+    fprintf(log->file, "%d %d %d %d %d %d %d %d %d %d\n", cmd.image, cmd.sx,
+            cmd.sy, cmd.sw, cmd.sh, cmd.dx, cmd.dy, cmd.dw, cmd.dh,
+            (int)cmd.depth);
+  }
+
+  // Layers are declared in draw order, so a command from a lower layer after
+  // a higher one is hidden under it, e.g. mail under a plate
+  auto top = Layer::Room;
+  for (auto &cmd : draw->commands) {
+    if (cmd.depth < top) {
+      printf("Frame %u draws layer %d after layer %d\n",
+             currentTick(it.world()), (int)cmd.depth, (int)top);
+      log->misordered++;
+      break;
+    }
+    top = cmd.depth;
+  }
+}
+
+void initRenderBackend(flecs::world &ecs) {
+  // Headless builds record draw commands like the web build, they are only
+  // executed when the software renderer is enabled.
+  ecs.component<NativeRenderer>();
+  ecs.component<DrawLog>();
+  ecs.add<NativeRenderer>();
+
+  ecs.system<NativeRenderer, ImageAsset>("loadImages")
+      .kind(flecs::PreFrame)
+      .term_at(1)
+      .singleton()
+      .term_at(2)
+      .self()
+      .without<ImageAsset::IsLoaded>()
+      .each(loadImages);
+
+  ecs.system<NativeRenderer, const game::Room>("buildRoomRender")
+      .term_at(1)
+      .singleton()
+      .without<RenderRoom>()
+      .write<RenderRoom>()
+      .with<ImageAsset::IsLoaded>()
+      .up<DependsOn>()
+      .each(buildRoom);
+  ecs.system<NativeRenderer, const game::Room>("buildRoomRenderDirty")
+      .term_at(1)
+      .singleton()
+      .with<game::Room::IsDirty>()
+      .write<RenderRoom>()
+      .with<ImageAsset::IsLoaded>()
+      .up<DependsOn>()
+      .each(buildRoom);
+
+  ecs.system<NativeRenderer, const DrawCommands>("renderFrame")
+      .kind(flecs::PostFrame)
+      .term_at(2)
+      .singleton()
+      .each(renderFrame);
+
+  ecs.system<DrawLog, const DrawCommands>("writeDrawLog")
+      .kind(flecs::PostFrame)
+      .term_at(1)
+      .singleton()
+      .term_at(2)
+      .singleton()
+      .iter(writeDrawLog);
+}
+
+} // namespace ld53::render
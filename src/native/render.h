@@ -0,0 +1,17 @@
+#pragma once
+
+#include <flecs.h>
+
+namespace ld53::render {
+
+// Writes every frame's draw commands as text so runs can be diffed
+bool openDrawLog(flecs::world &ecs, const char *path);
+// False if any logged frame drew its layers out of order
+bool drawLogInOrder(flecs::world &ecs);
+
+// Executes the draw commands with the CPU renderer instead of dropping
+// them. Must be called before the first frame so images get decoded.
+void enableSoftwareRender(flecs::world &ecs);
+// Writes the last rendered frame scaled up by `scale` as a PNG
+bool writeFrame(flecs::world &ecs, const char *path, int scale);
+} // namespace ld53::render
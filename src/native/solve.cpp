@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <flecs.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "assets.h"
+#include "game/common.h"
+#include "game/room.h"
+#include "native/data.h"
+#include "solver/solver.h"
+
+using namespace ld53;
+
+int main(int argc, char **argv) {
+  solver::SolveOptions options;
+  options.threads = (int)std::thread::hardware_concurrency();
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-depth") && i + 1 < argc) {
+      options.maxDepth = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--table-bits") && i + 1 < argc) {
+      options.tableBits = atoi(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      names.push_back(argv[i]);
+    } else {
+      printf("Usage: %s [--threads N] [--max-depth N] [--table-bits N] "
+             "[Level1 ...]\n",
+             argv[0]);
+      return 1;
+    }
+  }
+
+  flecs::world ecs;
+  assets::loadAssets(ecs);
+  game::initGame(ecs);
+
+  if (!game::mapLevelPack(ecs))
+    return 1;
+  auto pack = ecs.get<game::LevelPack>()->view;
+  // Every room that leads somewhere, the last one is the ending
+  if (names.empty()) {
+    for (int i = 0; i < pack.room_count(); i++) {
+      game::LevelView level;
+      if (pack.room(i, level) && level.next != game::NO_ROOM)
+        names.emplace_back(level.name);
+    }
+  }
+
+  int failed = 0;
+  for (auto &name : names) {
+    auto index = pack.find(name);
+    auto room = index < 0 ? flecs::entity() : game::loadRoom(ecs, index);
+    solver::Puzzle puzzle;
+    if (!room || !solver::extractPuzzle(room, puzzle)) {
+      printf("%s: unknown level\n", name.c_str());
+      failed++;
+      continue;
+    }
+
+    auto solution = solver::solve(puzzle, options);
+    printf("%s: ", name.c_str());
+    if (solution.solved) {
+      printf("%zu moves ", solution.moves.size());
+      for (auto move : solution.moves)
+        printf("%s", solver::actionName(move));
+    } else {
+      printf("no solution");
+      failed++;
+    }
+    printf("\n  %llu states, %llu nodes in %.3fs (%.0f nodes/s)\n",
+           (unsigned long long)solution.states,
+           (unsigned long long)solution.nodes, solution.seconds,
+           solution.nodes / std::max(solution.seconds, 1e-9));
+  }
+  return failed ? 1 : 0;
+}
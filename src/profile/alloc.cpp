@@ -0,0 +1,48 @@
+#include "alloc.h"
+
+#include <flecs.h>
+
+namespace ld53::profile {
+
+namespace {
+
+// The defaults flecs would have used, the counting versions forward to them
+ecs_os_api_malloc_t baseMalloc;
+ecs_os_api_calloc_t baseCalloc;
+ecs_os_api_realloc_t baseRealloc;
+
+void *countedMalloc(ecs_size_t size) {
+  countAllocation((size_t)size);
+  return baseMalloc(size);
+}
+
+void *countedCalloc(ecs_size_t size) {
+  countAllocation((size_t)size);
+  return baseCalloc(size);
+}
+
+void *countedRealloc(void *ptr, ecs_size_t size) {
+  countAllocation((size_t)size);
+  return baseRealloc(ptr, size);
+}
+
+} // namespace
+
+AllocCounter &allocCounter() {
+  static AllocCounter counter;
+  return counter;
+}
+
+void countFlecsAllocations() {
+  ecs_os_set_api_defaults();
+  ecs_os_api_t api = ecs_os_api;
+  baseMalloc = api.malloc_;
+  baseCalloc = api.calloc_;
+  baseRealloc = api.realloc_;
+  api.malloc_ = countedMalloc;
+  api.calloc_ = countedCalloc;
+  api.realloc_ = countedRealloc;
+  ecs_os_set_api(&api);
+}
+
+} // namespace ld53::profile
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ld53::profile {
+
+// Every heap allocation made through flecs' OS API, and through operator new
+// where the executable replaces it (see native/alloc.cpp). Reallocations
+// count as allocations, frees aren't counted.
+struct AllocCounter {
+  uint64_t count{0};
+  uint64_t bytes{0};
+};
+
+AllocCounter &allocCounter();
+inline void countAllocation(size_t size) {
+  auto &counter = allocCounter();
+  counter.count++;
+  counter.bytes += size;
+}
+
+// Routes flecs' malloc, calloc and realloc through the counter. Has to be
+// called before the first world is created.
+void countFlecsAllocations();
+} // namespace ld53::profile
@@ -0,0 +1,219 @@
+#include "profile.h"
+#include "alloc.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace ld53::profile {
+
+namespace {
+
+uint64_t frameStart = 0;
+uint64_t frameAllocStart = 0;
+
+// Stands in for the pipeline's own iteration of a system. The system's
+// index in Profiler::systems plus one is carried in its ctx, as a null ctx
+// is taken to mean the ctx isn't being set.
+void runProfiled(ecs_iter_t *it) {
+  auto allocs = allocCounter().count;
+  auto start = now();
+  if (it->field_count) {
+    while (ecs_iter_next(it))
+      it->callback(it);
+  } else {
+    it->callback(it);
+    ecs_iter_fini(it);
+  }
+  auto end = now();
+  auto index = (uintptr_t)it->ctx - 1;
+  profiler().current[index] += (uint32_t)(end - start);
+  profiler().currentAllocs[index] += (uint32_t)(allocCounter().count - allocs);
+  if (tracer().enabled) {
+    tracer().events.push_back(
+        {TraceEvent::Kind::System, start, end, index, 0});
+  }
+}
+
+int phaseDepth(flecs::world &ecs, flecs::entity_t phase) {
+  int depth = 0;
+  for (auto e = ecs.entity(phase); e; e = e.target(flecs::DependsOn))
+    depth++;
+  return depth;
+}
+
+} // namespace
+
+uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+Profiler &profiler() {
+  static Profiler p;
+  return p;
+}
+
+void installProfiler(flecs::world &ecs) {
+  auto &p = profiler();
+  std::vector<std::pair<int, flecs::entity>> found;
+  ecs.filter_builder().with(flecs::System).build().each([&](flecs::entity e) {
+    auto phase = e.target(flecs::DependsOn);
+    found.push_back({phase ? phaseDepth(ecs, phase) : 0, e});
+  });
+  std::sort(found.begin(), found.end(), [](auto &a, auto &b) {
+    return a.first != b.first ? a.first < b.first
+                              : a.second.id() < b.second.id();
+  });
+
+  for (auto &[depth, e] : found) {
+    auto phase = e.target(flecs::DependsOn);
+    auto existing =
+        std::find_if(p.phases.begin(), p.phases.end(),
+                     [&](auto &known) { return known.entity == phase; });
+    if (existing == p.phases.end()) {
+      p.phases.push_back({phase, phase ? phase.name().c_str() : "None"});
+      existing = p.phases.end() - 1;
+    }
+
+    ecs_system_desc_t desc = {};
+    desc.entity = e;
+    desc.run = runProfiled;
+    desc.ctx = (void *)(uintptr_t)(p.systems.size() + 1);
+    ecs_system_init(ecs, &desc);
+    p.systems.push_back(
+        {e, (size_t)(existing - p.phases.begin()), e.name().c_str()});
+  }
+
+  p.samples.assign(PROFILE_FRAMES * p.systems.size(), 0);
+  p.allocSamples.assign(PROFILE_FRAMES * p.systems.size(), 0);
+  p.current = p.samples.data();
+  p.currentAllocs = p.allocSamples.data();
+}
+
+void beginFrame() {
+  auto &p = profiler();
+  auto slot = (uint32_t)(p.frames % PROFILE_FRAMES);
+  p.current = p.samples.data() + slot * p.systems.size();
+  p.currentAllocs = p.allocSamples.data() + slot * p.systems.size();
+  std::fill(p.current, p.current + p.systems.size(), 0);
+  std::fill(p.currentAllocs, p.currentAllocs + p.systems.size(), 0);
+  frameAllocStart = allocCounter().count;
+  frameStart = now();
+}
+
+void endFrame(int ticks) {
+  auto &p = profiler();
+  auto slot = (uint32_t)(p.frames % PROFILE_FRAMES);
+  p.frameTime[slot] = (uint32_t)(now() - frameStart);
+  p.frameTicks[slot] = (uint16_t)ticks;
+  p.frameAllocs[slot] = (uint32_t)(allocCounter().count - frameAllocStart);
+  p.frames++;
+}
+
+std::vector<SystemTime> topSystems(size_t count) {
+  auto &p = profiler();
+  std::vector<SystemTime> out;
+  auto frames = p.recorded();
+  if (!frames)
+    return out;
+  for (auto &system : p.systems)
+    out.push_back({&system, 0});
+  for (uint32_t age = 0; age < frames; age++) {
+    auto row = p.row(p.slot(age));
+    for (size_t i = 0; i < p.systems.size(); i++)
+      out[i].averageNs += row[i];
+  }
+  for (auto &time : out)
+    time.averageNs /= frames;
+  count = std::min(count, out.size());
+  std::partial_sort(out.begin(), out.begin() + count, out.end(),
+                    [](auto &a, auto &b) { return a.averageNs > b.averageNs; });
+  out.resize(count);
+  return out;
+}
+
+std::vector<double> phaseTimes() {
+  auto &p = profiler();
+  std::vector<double> out(p.phases.size());
+  auto frames = p.recorded();
+  if (!frames)
+    return out;
+  for (uint32_t age = 0; age < frames; age++) {
+    auto row = p.row(p.slot(age));
+    for (size_t i = 0; i < p.systems.size(); i++)
+      out[p.systems[i].phase] += row[i];
+  }
+  for (auto &time : out)
+    time /= frames;
+  return out;
+}
+
+bool writeProfile(const char *path) {
+  auto &p = profiler();
+  auto file = fopen(path, "w");
+  if (!file)
+    return false;
+  auto length = strlen(path);
+  bool json = length >= 5 && !strcmp(path + length - 5, ".json");
+  auto frames = p.recorded();
+
+  if (json) {
+    fprintf(file, "{\"phases\":[");
+    for (size_t i = 0; i < p.phases.size(); i++)
+      fprintf(file, "%s\"%s\"", i ? "," : "", p.phases[i].name.c_str());
+    fprintf(file, "],\"systems\":[");
+    for (size_t i = 0; i < p.systems.size(); i++) {
+      auto &system = p.systems[i];
+      fprintf(file, "%s{\"name\":\"%s\",\"phase\":\"%s\"}", i ? "," : "",
+              system.name.c_str(), p.phases[system.phase].name.c_str());
+    }
+    fprintf(file, "],\"frames\":[");
+  } else {
+    fprintf(file, "frame,ticks,frame_ns,frame_allocs");
+    for (auto &system : p.systems)
+      fprintf(file, ",%s", system.name.c_str());
+    for (auto &system : p.systems)
+      fprintf(file, ",%s_allocs", system.name.c_str());
+    fprintf(file, "\n");
+  }
+
+  for (uint32_t age = frames; age-- > 0;) {
+    auto slot = p.slot(age);
+    auto row = p.row(slot);
+    auto allocRow = p.allocRow(slot);
+    auto frame = (unsigned long long)(p.frames - 1 - age);
+    if (json) {
+      fprintf(file,
+              "%s{\"frame\":%llu,\"ticks\":%u,\"frame_ns\":%u,"
+              "\"frame_allocs\":%u,\"system_ns\":[",
+              age + 1 == frames ? "" : ",", frame, p.frameTicks[slot],
+              p.frameTime[slot], p.frameAllocs[slot]);
+      for (size_t i = 0; i < p.systems.size(); i++)
+        fprintf(file, "%s%u", i ? "," : "", row[i]);
+      fprintf(file, "],\"system_allocs\":[");
+      for (size_t i = 0; i < p.systems.size(); i++)
+        fprintf(file, "%s%u", i ? "," : "", allocRow[i]);
+      fprintf(file, "]}");
+    } else {
+      fprintf(file, "%llu,%u,%u,%u", frame, p.frameTicks[slot],
+              p.frameTime[slot], p.frameAllocs[slot]);
+      for (size_t i = 0; i < p.systems.size(); i++)
+        fprintf(file, ",%u", row[i]);
+      for (size_t i = 0; i < p.systems.size(); i++)
+        fprintf(file, ",%u", allocRow[i]);
+      fprintf(file, "\n");
+    }
+  }
+  if (json)
+    fprintf(file, "]}\n");
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+} // namespace ld53::profile
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <flecs.h>
+#include <string>
+#include <vector>
+
+namespace ld53::profile {
+
+constexpr uint32_t PROFILE_FRAMES = 600;
+// Systems listed by the HUD, slowest first
+constexpr int HUD_TOP_SYSTEMS = 6;
+
+struct ProfiledPhase {
+  flecs::entity_t entity;
+  std::string name;
+};
+
+struct ProfiledSystem {
+  flecs::entity_t entity;
+  // Index into Profiler::phases
+  size_t phase;
+  std::string name;
+};
+
+// Wall time and heap allocations of every system over the last
+// PROFILE_FRAMES frames. A frame is one pass of the platform loop (an
+// animation frame on the web) along with however many ticks it ran.
+// Everything is sized when the profiler is installed, recording a sample is
+// two clock reads and a couple of adds.
+struct Profiler {
+  // In pipeline order
+  std::vector<ProfiledSystem> systems;
+  std::vector<ProfiledPhase> phases;
+  // Nanoseconds per system, a row of systems.size() per frame
+  std::vector<uint32_t> samples;
+  // Allocations per system, laid out like samples
+  std::vector<uint32_t> allocSamples;
+  std::array<uint32_t, PROFILE_FRAMES> frameTime{};
+  std::array<uint16_t, PROFILE_FRAMES> frameTicks{};
+  // Everything allocated over the frame, systems or not
+  std::array<uint32_t, PROFILE_FRAMES> frameAllocs{};
+  // Frames recorded so far, the newest is `frames - 1`
+  uint64_t frames{0};
+  // Rows samples are currently added to
+  uint32_t *current{nullptr};
+  uint32_t *currentAllocs{nullptr};
+  bool hud{false};
+
+  uint32_t recorded() const {
+    return frames < PROFILE_FRAMES ? (uint32_t)frames : PROFILE_FRAMES;
+  }
+  // Ring slot of the recorded frame `age` frames before the newest
+  uint32_t slot(uint32_t age) const {
+    return (uint32_t)((frames - 1 - age) % PROFILE_FRAMES);
+  }
+  const uint32_t *row(uint32_t slot) const {
+    return samples.data() + slot * systems.size();
+  }
+  const uint32_t *allocRow(uint32_t slot) const {
+    return allocSamples.data() + slot * systems.size();
+  }
+};
+
+struct SystemTime {
+  const ProfiledSystem *system;
+  // Averaged over the recorded frames
+  double averageNs;
+};
+
+// Steady clock in nanoseconds
+uint64_t now();
+Profiler &profiler();
+// Wraps every system that exists so far, so call it after everything is
+// registered
+void installProfiler(flecs::world &ecs);
+void beginFrame();
+void endFrame(int ticks);
+
+// Slowest systems first, at most `count`
+std::vector<SystemTime> topSystems(size_t count);
+// Average time of each of `Profiler::phases`
+std::vector<double> phaseTimes();
+
+// Writes the recorded frames oldest first, as JSON if the path ends in .json
+// and CSV otherwise
+bool writeProfile(const char *path);
+} // namespace ld53::profile
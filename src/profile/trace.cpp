@@ -0,0 +1,158 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "profile.h"
+
+namespace ld53::profile {
+
+namespace {
+
+// Every id an entity gains or loses moves it to another table
+void traceStructural(flecs::iter &it) {
+  auto kind = it.event() == flecs::OnAdd ? TraceEvent::Kind::Add
+                                         : TraceEvent::Kind::Remove;
+  auto id = it.event_id().raw_id();
+  auto time = now();
+  for (auto i : it)
+    tracer().events.push_back({kind, time, time, it.entity(i).id(), id});
+}
+
+std::string entityName(flecs::world &ecs, uint64_t entity) {
+  if (ecs.is_alive(entity)) {
+    auto e = ecs.entity(entity);
+    if (e.name().length())
+      return e.path().c_str();
+  }
+  return "#" + std::to_string((uint32_t)entity);
+}
+
+// Names are only ever flecs paths, which don't need escaping beyond this
+std::string escaped(const std::string &text) {
+  std::string out;
+  for (auto c : text) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+} // namespace
+
+Tracer &tracer() {
+  static Tracer t;
+  return t;
+}
+
+void startTrace(flecs::world &ecs) {
+  auto &t = tracer();
+  t.enabled = true;
+  t.events.reserve(1 << 16);
+  ecs.observer<>("traceAdd")
+      .event(flecs::OnAdd)
+      .event(flecs::OnRemove)
+      .with(flecs::Wildcard)
+      .self()
+      .iter(traceStructural);
+  ecs.observer<>("tracePairs")
+      .event(flecs::OnAdd)
+      .event(flecs::OnRemove)
+      .with(flecs::Wildcard, flecs::Wildcard)
+      .self()
+      .iter(traceStructural);
+}
+
+void traceProgress(TraceEvent::Kind kind, uint64_t start) {
+  if (tracer().enabled)
+    tracer().events.push_back({kind, start, now(), 0, 0});
+}
+
+bool writeTrace(flecs::world &ecs, const char *path) {
+  auto &t = tracer();
+  auto &p = profiler();
+  // Teardown would otherwise be traced too
+  t.enabled = false;
+  auto file = fopen(path, "w");
+  if (!file)
+    return false;
+  uint64_t base = t.events.empty() ? 0 : t.events.front().start;
+  for (auto &event : t.events)
+    base = std::min(base, event.start);
+
+  bool first = true;
+  auto span = [&](const char *cat, const std::string &name, uint64_t start,
+                  uint64_t end) {
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+            "\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+            first ? "" : ",", escaped(name).c_str(), cat,
+            (start - base) / 1000.0, (end - start) / 1000.0);
+    first = false;
+  };
+
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  // A phase is open while systems from it keep running in the same progress
+  size_t phase = SIZE_MAX;
+  uint64_t phaseStart = 0, phaseEnd = 0;
+  auto closePhase = [&]() {
+    if (phase != SIZE_MAX)
+      span("phase", p.phases[phase].name, phaseStart, phaseEnd);
+    phase = SIZE_MAX;
+  };
+
+  uint32_t ticks = 0;
+  for (auto &event : t.events) {
+    switch (event.kind) {
+    case TraceEvent::Kind::Tick:
+      closePhase();
+      span("progress", "tick " + std::to_string(ticks++), event.start,
+           event.end);
+      break;
+    case TraceEvent::Kind::Present:
+      closePhase();
+      span("progress", "present", event.start, event.end);
+      break;
+    case TraceEvent::Kind::System: {
+      auto &system = p.systems[event.entity];
+      if (system.phase != phase) {
+        closePhase();
+        phase = system.phase;
+        phaseStart = event.start;
+      }
+      phaseEnd = event.end;
+      span("system", system.name, event.start, event.end);
+      break;
+    }
+    case TraceEvent::Kind::Add:
+    case TraceEvent::Kind::Remove: {
+      std::string name =
+          event.kind == TraceEvent::Kind::Add ? "add " : "remove ";
+      // Pairs whose target has since been deleted can't be named
+      if (ecs_id_is_valid(ecs, event.id))
+        name += ecs.id(event.id).str().c_str();
+      else
+        name += "#" + std::to_string(event.id);
+      fprintf(file,
+              "%s\n{\"name\":\"%s\",\"cat\":\"structural\",\"ph\":\"i\","
+              "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":1,"
+              "\"args\":{\"entity\":\"%s\"}}",
+              first ? "" : ",", escaped(name).c_str(),
+              (event.start - base) / 1000.0,
+              escaped(entityName(ecs, event.entity)).c_str());
+      first = false;
+      break;
+    }
+    }
+  }
+  closePhase();
+  fprintf(file, "\n]}\n");
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+} // namespace ld53::profile
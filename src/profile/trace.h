@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <flecs.h>
+#include <vector>
+
+namespace ld53::profile {
+
+struct TraceEvent {
+  enum class Kind : uint8_t {
+    Tick,
+    Present,
+    System,
+    Add,
+    Remove,
+  };
+  Kind kind;
+  uint64_t start;
+  uint64_t end;
+  // System index for spans, the entity and id changed for structural events
+  uint64_t entity;
+  flecs::id_t id;
+};
+
+// Everything recorded since tracing started, written out as Chrome trace
+// events. Off unless started, the profiler's system wrapper is what records
+// system spans so it has to be installed too.
+struct Tracer {
+  bool enabled{false};
+  std::vector<TraceEvent> events;
+};
+
+Tracer &tracer();
+void startTrace(flecs::world &ecs);
+// Records a span for one ecs.progress()
+void traceProgress(TraceEvent::Kind kind, uint64_t start);
+
+// JSON trace event format, loads in Perfetto and chrome://tracing. Phase
+// spans are rebuilt from the runs of systems in the same phase.
+bool writeTrace(flecs::world &ecs, const char *path);
+} // namespace ld53::profile
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ld53::render {
+
+// Draw order bucket a command was recorded from. Commands are kept in
+// submission order, the layer is carried along so frames can be diffed.
+enum class Layer : int32_t {
+  Room,
+  Sprite,
+  Background,
+  Fixture,
+  Movable,
+  Player,
+  Overlay,
+};
+
+// A single image blit. Plain int32s so the web flush can read the buffer
+// straight out of wasm memory as an Int32Array, stride is
+// `DRAW_COMMAND_INTS`. A zero source size draws the whole image unscaled.
+struct DrawCommand {
+  int32_t image;
+  int32_t sx, sy, sw, sh;
+  int32_t dx, dy, dw, dh;
+  Layer depth;
+
+  bool operator==(const DrawCommand &) const = default;
+};
+constexpr int DRAW_COMMAND_INTS = sizeof(DrawCommand) / sizeof(int32_t);
+static_assert(DRAW_COMMAND_INTS == 10);
+
+struct DrawCommands {
+  std::vector<DrawCommand> commands;
+
+  void blit(int32_t image, int sx, int sy, int w, int h, int dx, int dy,
+            Layer layer) {
+    commands.push_back({image, sx, sy, w, h, dx, dy, w, h, layer});
+  }
+  void blitWhole(int32_t image, int dx, int dy, Layer layer) {
+    commands.push_back({image, 0, 0, 0, 0, dx, dy, 0, 0, layer});
+  }
+  void clear() { commands.clear(); }
+};
+
+} // namespace ld53::render
@@ -0,0 +1,434 @@
+#include "png.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace ld53::render {
+
+namespace {
+
+// Minimal inflate for the zlib stream inside PNGs, follows zlib's puff.c
+struct BitReader {
+  const uint8_t *data;
+  size_t size;
+  size_t pos{0};
+  uint32_t bitBuf{0};
+  int bitCount{0};
+  bool error{false};
+
+  int bits(int need) {
+    uint32_t val = bitBuf;
+    while (bitCount < need) {
+      if (pos >= size) {
+        error = true;
+        return 0;
+      }
+      val |= (uint32_t)data[pos++] << bitCount;
+      bitCount += 8;
+    }
+    bitBuf = val >> need;
+    bitCount -= need;
+    return (int)(val & ((1u << need) - 1));
+  }
+};
+
+constexpr int MAX_BITS = 15;
+
+struct Huffman {
+  std::array<short, MAX_BITS + 1> count{};
+  std::array<short, 288> symbol{};
+
+  bool build(const short *lengths, int n) {
+    count.fill(0);
+    for (int i = 0; i < n; i++)
+      count[lengths[i]]++;
+    if (count[0] == n)
+      return true;
+
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; len++) {
+      left <<= 1;
+      left -= count[len];
+      if (left < 0)
+        return false;
+    }
+
+    std::array<short, MAX_BITS + 1> offs{};
+    for (int len = 1; len < MAX_BITS; len++)
+      offs[len + 1] = offs[len] + count[len];
+    for (int i = 0; i < n; i++) {
+      if (lengths[i] != 0)
+        symbol[offs[lengths[i]]++] = (short)i;
+    }
+    return true;
+  }
+
+  int decode(BitReader &in) const {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+      code |= in.bits(1);
+      int n = count[len];
+      if (code - n < first)
+        return symbol[index + (code - first)];
+      index += n;
+      first += n;
+      first <<= 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+};
+
+constexpr short LENGTH_BASE[29] = {3,  4,  5,  6,   7,   8,   9,   10,
+                                   11, 13, 15, 17,  19,  23,  27,  31,
+                                   35, 43, 51, 59,  67,  83,  99,  115,
+                                   131, 163, 195, 227, 258};
+constexpr short LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                    1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                    4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr short DIST_BASE[30] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,   97,   129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr short DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                  4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                  9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+bool inflateCodes(BitReader &in, std::vector<uint8_t> &out,
+                  const Huffman &lencode, const Huffman &distcode) {
+  for (;;) {
+    int symbol = lencode.decode(in);
+    if (symbol < 0 || in.error)
+      return false;
+    if (symbol < 256) {
+      out.push_back((uint8_t)symbol);
+    } else if (symbol == 256) {
+      return true;
+    } else {
+      symbol -= 257;
+      if (symbol >= 29)
+        return false;
+      int len = LENGTH_BASE[symbol] + in.bits(LENGTH_EXTRA[symbol]);
+
+      symbol = distcode.decode(in);
+      if (symbol < 0 || symbol >= 30)
+        return false;
+      size_t dist = DIST_BASE[symbol] + in.bits(DIST_EXTRA[symbol]);
+      if (dist > out.size() || in.error)
+        return false;
+
+      size_t from = out.size() - dist;
+      for (int i = 0; i < len; i++)
+        out.push_back(out[from + i]);
+    }
+  }
+}
+
+bool inflateStored(BitReader &in, std::vector<uint8_t> &out) {
+  in.bitBuf = 0;
+  in.bitCount = 0;
+  if (in.pos + 4 > in.size)
+    return false;
+  unsigned len = in.data[in.pos] | (in.data[in.pos + 1] << 8);
+  unsigned nlen = in.data[in.pos + 2] | (in.data[in.pos + 3] << 8);
+  in.pos += 4;
+  if (len != (~nlen & 0xffff) || in.pos + len > in.size)
+    return false;
+  out.insert(out.end(), in.data + in.pos, in.data + in.pos + len);
+  in.pos += len;
+  return true;
+}
+
+bool inflateFixed(BitReader &in, std::vector<uint8_t> &out) {
+  static Huffman lencode, distcode;
+  static bool built = false;
+  if (!built) {
+    short lengths[288];
+    int symbol = 0;
+    for (; symbol < 144; symbol++)
+      lengths[symbol] = 8;
+    for (; symbol < 256; symbol++)
+      lengths[symbol] = 9;
+    for (; symbol < 280; symbol++)
+      lengths[symbol] = 7;
+    for (; symbol < 288; symbol++)
+      lengths[symbol] = 8;
+    lencode.build(lengths, 288);
+    for (symbol = 0; symbol < 30; symbol++)
+      lengths[symbol] = 5;
+    distcode.build(lengths, 30);
+    built = true;
+  }
+  return inflateCodes(in, out, lencode, distcode);
+}
+
+bool inflateDynamic(BitReader &in, std::vector<uint8_t> &out) {
+  constexpr short ORDER[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                               11, 4,  12, 3, 13, 2, 14, 1, 15};
+  int nlen = in.bits(5) + 257;
+  int ndist = in.bits(5) + 1;
+  int ncode = in.bits(4) + 4;
+  if (nlen > 286 || ndist > 30 || in.error)
+    return false;
+
+  short lengths[286 + 30]{};
+  for (int i = 0; i < ncode; i++)
+    lengths[ORDER[i]] = (short)in.bits(3);
+
+  Huffman lencode, distcode;
+  if (!lencode.build(lengths, 19))
+    return false;
+
+  int index = 0;
+  while (index < nlen + ndist) {
+    int symbol = lencode.decode(in);
+    if (symbol < 0 || in.error)
+      return false;
+    if (symbol < 16) {
+      lengths[index++] = (short)symbol;
+      continue;
+    }
+    short len = 0;
+    if (symbol == 16) {
+      if (index == 0)
+        return false;
+      len = lengths[index - 1];
+      symbol = 3 + in.bits(2);
+    } else if (symbol == 17) {
+      symbol = 3 + in.bits(3);
+    } else {
+      symbol = 11 + in.bits(7);
+    }
+    if (index + symbol > nlen + ndist)
+      return false;
+    while (symbol--)
+      lengths[index++] = len;
+  }
+  if (lengths[256] == 0)
+    return false;
+
+  if (!lencode.build(lengths, nlen) || !distcode.build(lengths + nlen, ndist))
+    return false;
+  return inflateCodes(in, out, lencode, distcode);
+}
+
+bool zlibInflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+  if (size < 2 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31)
+    return false;
+  BitReader in{data + 2, size - 2};
+  int last;
+  do {
+    last = in.bits(1);
+    int type = in.bits(2);
+    bool ok = false;
+    if (type == 0)
+      ok = inflateStored(in, out);
+    else if (type == 1)
+      ok = inflateFixed(in, out);
+    else if (type == 2)
+      ok = inflateDynamic(in, out);
+    if (!ok || in.error)
+      return false;
+  } while (!last);
+  return true;
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  static std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t readBE32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+void writeBE32(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+constexpr uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+int paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+} // namespace
+
+bool decodePng(const uint8_t *data, size_t size, Pixels &out) {
+  if (size < 8 || memcmp(data, SIGNATURE, 8) != 0)
+    return false;
+
+  int width = 0, height = 0, colourType = 0;
+  std::vector<uint8_t> compressed;
+  for (size_t pos = 8; pos + 12 <= size;) {
+    uint32_t len = readBE32(data + pos);
+    auto type = data + pos + 4;
+    auto body = data + pos + 8;
+    if (pos + 12 + len > size)
+      return false;
+    if (!memcmp(type, "IHDR", 4) && len >= 13) {
+      width = (int)readBE32(body);
+      height = (int)readBE32(body + 4);
+      colourType = body[9];
+      // Only what our assets use: 8 bit RGB(A), no interlacing
+      if (body[8] != 8 || (colourType != 2 && colourType != 6) ||
+          body[12] != 0)
+        return false;
+    } else if (!memcmp(type, "IDAT", 4)) {
+      compressed.insert(compressed.end(), body, body + len);
+    } else if (!memcmp(type, "IEND", 4)) {
+      break;
+    }
+    pos += 12 + len;
+  }
+  if (width <= 0 || height <= 0)
+    return false;
+
+  std::vector<uint8_t> raw;
+  if (!zlibInflate(compressed.data(), compressed.size(), raw))
+    return false;
+
+  int bpp = colourType == 6 ? 4 : 3;
+  size_t stride = (size_t)width * bpp;
+  if (raw.size() < (stride + 1) * height)
+    return false;
+
+  out.resize(width, height);
+  std::vector<uint8_t> prev(stride, 0);
+  for (int y = 0; y < height; y++) {
+    uint8_t filter = raw[y * (stride + 1)];
+    uint8_t *line = raw.data() + y * (stride + 1) + 1;
+    for (size_t i = 0; i < stride; i++) {
+      int a = i >= (size_t)bpp ? line[i - bpp] : 0;
+      int b = prev[i];
+      int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+      switch (filter) {
+      case 0:
+        break;
+      case 1:
+        line[i] += a;
+        break;
+      case 2:
+        line[i] += b;
+        break;
+      case 3:
+        line[i] += (a + b) / 2;
+        break;
+      case 4:
+        line[i] += paeth(a, b, c);
+        break;
+      default:
+        return false;
+      }
+    }
+    auto row = out.row(y);
+    for (int x = 0; x < width; x++) {
+      auto p = line + x * bpp;
+      uint32_t alpha = bpp == 4 ? p[3] : 0xff;
+      row[x] = p[0] | (p[1] << 8) | (p[2] << 16) | (alpha << 24);
+    }
+    memcpy(prev.data(), line, stride);
+  }
+  return true;
+}
+
+bool loadPng(const char *path, Pixels &out) {
+  auto file = fopen(path, "rb");
+  if (!file)
+    return false;
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t read;
+  while ((read = fread(buf, 1, sizeof(buf), file)) > 0)
+    data.insert(data.end(), buf, buf + read);
+  fclose(file);
+  return decodePng(data.data(), data.size(), out);
+}
+
+std::vector<uint8_t> encodePng(const Pixels &pixels) {
+  // Rows are stored unfiltered in uncompressed deflate blocks, this is for
+  // debug output so size doesn't matter.
+  std::vector<uint8_t> raw;
+  raw.reserve((size_t)pixels.height * (pixels.width * 4 + 1));
+  for (int y = 0; y < pixels.height; y++) {
+    raw.push_back(0);
+    auto row = pixels.row(y);
+    for (int x = 0; x < pixels.width; x++) {
+      raw.push_back(row[x]);
+      raw.push_back(row[x] >> 8);
+      raw.push_back(row[x] >> 16);
+      raw.push_back(row[x] >> 24);
+    }
+  }
+
+  std::vector<uint8_t> zlib{0x78, 0x01};
+  size_t pos = 0;
+  do {
+    size_t len = std::min<size_t>(raw.size() - pos, 0xffff);
+    zlib.push_back(pos + len == raw.size() ? 1 : 0);
+    zlib.push_back(len);
+    zlib.push_back(len >> 8);
+    zlib.push_back(~len);
+    zlib.push_back(~len >> 8);
+    zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+    pos += len;
+  } while (pos < raw.size());
+
+  uint32_t a = 1, b = 0;
+  for (auto byte : raw) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  writeBE32(zlib, (b << 16) | a);
+
+  std::vector<uint8_t> out{SIGNATURE, SIGNATURE + 8};
+  auto chunk = [&](const char *type, const std::vector<uint8_t> &body) {
+    writeBE32(out, body.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), body.begin(), body.end());
+    writeBE32(out, crc32(out.data() + start, out.size() - start));
+  };
+
+  std::vector<uint8_t> header;
+  writeBE32(header, pixels.width);
+  writeBE32(header, pixels.height);
+  header.insert(header.end(), {8, 6, 0, 0, 0});
+  chunk("IHDR", header);
+  chunk("IDAT", zlib);
+  chunk("IEND", {});
+  return out;
+}
+
+bool writePng(const char *path, const Pixels &pixels) {
+  auto file = fopen(path, "wb");
+  if (!file)
+    return false;
+  auto data = encodePng(pixels);
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+  return ok;
+}
+
+} // namespace ld53::render
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "software.h"
+
+namespace ld53::render {
+
+// Decodes the 8 bit RGB/RGBA, non-interlaced PNGs in data/
+bool decodePng(const uint8_t *data, size_t size, Pixels &out);
+bool loadPng(const char *path, Pixels &out);
+
+std::vector<uint8_t> encodePng(const Pixels &pixels);
+bool writePng(const char *path, const Pixels &pixels);
+
+} // namespace ld53::render
@@ -0,0 +1,323 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "commands.h"
+#include "assets.h"
+#include "game/common.h"
+#include "game/room.h"
+#include "loop.h"
+
+namespace ld53::render {
+
+Layer layerOf(flecs::iter &it) {
+  auto depth = it.group_id();
+  auto ecs = it.world();
+  if (depth == ecs.id<Depth::Background>())
+    return Layer::Background;
+  if (depth == ecs.id<Depth::Fixture>())
+    return Layer::Fixture;
+  if (depth == ecs.id<Depth::Movable>())
+    return Layer::Movable;
+  if (depth == ecs.id<Depth::Player>())
+    return Layer::Player;
+  return Layer::Sprite;
+}
+
+bool bakeRoom(flecs::world ecs, const game::Room &room, DrawCommands &out) {
+  auto wall = ecs.id<ld53::assets::Tileset::Wall>();
+  auto wallBottom = ecs.id<ld53::assets::Tileset::WallBottom>();
+
+  for (int y = 0; y < game::ROOM_HEIGHT; y++) {
+    for (int x = 0; x < game::ROOM_WIDTH; x++) {
+      auto tile = ecs.entity(room.get_tile(x, y));
+      if (!tile)
+        continue;
+      if (!tile.has<ImageAsset::IsLoaded>()) {
+        // TODO: Handle this better?
+        printf("Not all tiles loaded\n");
+        return false;
+      }
+      auto image = tile.get<ImageAsset>()->handle;
+      if (auto section = tile.get<ImageTile>()) {
+        out.blit(image, section->x * 16, section->y * 16, 16, 16, x * 16,
+                 y * 16, Layer::Room);
+      } else {
+        out.blitWhole(image, x * 16, y * 16, Layer::Room);
+      }
+
+      // Lighting for walls
+      if (x > 0) {
+        auto side = room.get_tile(x - 1, y);
+        if (side == wall && tile != wall) {
+          bool top = tile == wallBottom ||
+                     (y > 0 && room.get_tile(x - 1, y - 1) != wall);
+          out.blit(image, 6 * 16, (top ? 0 : 1) * 16, 16, 16, x * 16, y * 16,
+                   Layer::Room);
+        } else if (side == wallBottom && (tile != wall && tile != wallBottom)) {
+          out.blit(image, 6 * 16, 2 * 16, 16, 16, x * 16, y * 16, Layer::Room);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void drawRoom(DrawCommands &draw, const game::Position &pos,
+              const RenderRoom &room) {
+  draw.blit(room.handle, 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT, pos.x, pos.y,
+            Layer::Room);
+}
+int AnimationClocks::find(flecs::entity_t tile, int frames, float rate) {
+  for (int i = 0; i < count; i++) {
+    if (clocks[i].tile == tile)
+      return i;
+  }
+  if (count == MAX_ANIMATION_CLOCKS)
+    return -1;
+  clocks[count] = {tile, frames, rate};
+  return count++;
+}
+
+void resolveSprite(flecs::entity e, const ImageAsset &img,
+                   const ImageTile *tile, const AnimatedTile *ani,
+                   AnimationClocks &clocks) {
+  SpriteRef sprite{img.handle};
+  if (tile) {
+    sprite.sx = tile->x * 16;
+    sprite.sy = tile->y * 16;
+    sprite.sw = 16;
+    sprite.sh = 16;
+  }
+  if (tile && ani)
+    sprite.clock = clocks.find(e.target<Image>(), ani->frames, ani->rate);
+  e.set<SpriteRef>(sprite);
+}
+
+void advanceAnimationClocks(flecs::iter &it, AnimationClocks *clocks) {
+  for (int i = 0; i < clocks->count; i++) {
+    auto &clock = clocks->clocks[i];
+    clock.nextFrame -= it.delta_time() * clock.rate;
+    if (clock.nextFrame <= 0) {
+      clock.nextFrame += 1;
+      clock.frame = (clock.frame + 1) % clock.frames;
+
+      // Safety in case of lag spike/pause on brower tab
+      if (clock.nextFrame <= -5)
+        clock.nextFrame = 0;
+    }
+  }
+}
+
+void drawSprite(flecs::iter &it, size_t i, DrawCommands &draw,
+                const game::Position &pos, const SpriteRef &sprite,
+                const AnimationPhase *phase, const AnimationClocks &clocks,
+                FrameClock &frameClock) {
+  if (!sprite.sw) {
+    draw.blitWhole(sprite.handle, pos.x, pos.y, layerOf(it));
+    return;
+  }
+  int frame = 0;
+  if (sprite.clock >= 0) {
+    auto &clock = clocks.clocks[sprite.clock];
+    frame = clock.frame;
+    if (phase)
+      frame = ((frame + phase->offset) % clock.frames + clock.frames) %
+              clock.frames;
+    // Only clocks something is shown with keep frames coming
+    frameClock.untilAnimation = std::min(
+        frameClock.untilAnimation, (double)(clock.nextFrame / clock.rate));
+  }
+  draw.blit(sprite.handle, sprite.sx + frame * sprite.sw, sprite.sy,
+            sprite.sw, sprite.sh, pos.x, pos.y, layerOf(it));
+}
+
+// Anything that moved further than a tile in one tick was placed there
+// (a room change, restart or undo), so it is shown there straight away
+constexpr int MAX_INTERPOLATE = 16;
+
+void interpolatePosition(flecs::iter &it, const game::Position *pos,
+                         const game::Position *prev, game::Position *drawn) {
+  auto alpha = it.world().get<FrameClock>()->alpha;
+  for (auto i : it) {
+    auto out = pos[i];
+    if (prev && abs(pos[i].x - prev[i].x) <= MAX_INTERPOLATE &&
+        abs(pos[i].y - prev[i].y) <= MAX_INTERPOLATE) {
+      out.x = prev[i].x + (int)lroundf((pos[i].x - prev[i].x) * alpha);
+      out.y = prev[i].y + (int)lroundf((pos[i].y - prev[i].y) * alpha);
+    }
+    if (drawn)
+      drawn[i] = out;
+    else
+      it.entity(i).set<game::Position, Drawn>(out);
+  }
+}
+
+void initRender(flecs::world &ecs) {
+  ecs.component<ImageAsset>().member<const char *>("path").member<int32_t>(
+      "handle");
+  ecs.component<ImageAsset::IsLoaded>();
+  ecs.component<RenderRoom>().member<int32_t>("handle");
+  ecs.component<DrawCommands>();
+  ecs.component<Image>().add(flecs::Exclusive).add(flecs::Traversable);
+  ecs.component<DependsOn>().add(flecs::Traversable);
+  ecs.component<ImageTile>().member<int>("x").member<int>("y");
+  ecs.component<AnimatedTile>().member<int>("frames").member<float>("rate");
+  ecs.component<AnimationPhase>().member<int>("offset");
+  ecs.component<SpriteRef>()
+      .member<int32_t>("handle")
+      .member<int>("sx")
+      .member<int>("sy")
+      .member<int>("sw")
+      .member<int>("sh")
+      .member<int>("clock");
+  ecs.component<AnimationClocks>();
+
+  ecs.component<Depth>().add(flecs::Exclusive);
+  ecs.component<Depth::Background>();
+  ecs.component<Depth::Fixture>();
+  ecs.component<Depth::Movable>();
+  ecs.component<Depth::Player>();
+
+  ecs.component<Drawn>();
+  ecs.add<DrawCommands>();
+  ecs.add<AnimationClocks>();
+
+  // Anything that moved last tick keeps frames being drawn
+  ecs.system<const game::Position, const game::Position, FrameClock>(
+         "wakeOnMovement")
+      .kind(flecs::OnLoad)
+      .term_at(1)
+      .second<game::World>()
+      .term_at(2)
+      .second<game::Previous>()
+      .term_at(3)
+      .singleton()
+      .without<game::AtRest>()
+      .iter([](flecs::iter &it, const game::Position *pos,
+               const game::Position *prev, FrameClock *clock) {
+        for (auto i : it) {
+          if (pos[i].x != prev[i].x || pos[i].y != prev[i].y) {
+            clock->wake();
+            return;
+          }
+        }
+      });
+  ecs.system<const game::Room, const RenderRoom *, FrameClock>("wakeOnRoom")
+      .kind(flecs::OnLoad)
+      .term_at(3)
+      .singleton()
+      .each([](flecs::entity e, const game::Room &room,
+               const RenderRoom *render, FrameClock &clock) {
+        if (!render || e.has<game::Room::IsDirty>())
+          clock.wake();
+      });
+  ecs.system<const game::Position, game::Position *>("storePreviousPosition")
+      .kind(flecs::OnLoad)
+      .term_at(1)
+      .second<game::World>()
+      .term_at(2)
+      .second<game::Previous>()
+      .without<game::AtRest>()
+      .each([](flecs::entity e, const game::Position &pos,
+               game::Position *prev) {
+        if (prev)
+          *prev = pos;
+        else
+          e.set<game::Position, game::Previous>(pos);
+      });
+  ecs.system<const game::Position, const game::Position *, game::Position *>(
+         "interpolatePosition")
+      .kind(flecs::PreStore)
+      .term_at(1)
+      .second<game::World>()
+      .term_at(2)
+      .second<game::Previous>()
+      .term_at(3)
+      .second<Drawn>()
+      .write<game::Position, Drawn>()
+      .iter(interpolatePosition);
+
+  // Draw systems only record commands, the backend flushes the buffer once
+  // per frame in PostFrame.
+  ecs.system<DrawCommands>("clearDrawCommands")
+      .kind(flecs::PreStore)
+      .term_at(1)
+      .singleton()
+      .iter([](flecs::iter &it, DrawCommands *draw) { draw->clear(); });
+
+  ecs.system<DrawCommands, const game::Position, const RenderRoom>("drawRoom")
+      .kind(flecs::OnStore)
+      .term_at(1)
+      .singleton()
+      .term_at(2)
+      .second<Drawn>()
+      .each(drawRoom);
+
+  // A new image target has to be resolved again, the old sprite is dropped
+  // until it is
+  ecs.observer<>("dropSprite")
+      .event(flecs::OnAdd)
+      .with<Image>(flecs::Wildcard)
+      .each([](flecs::entity e) { e.remove<SpriteRef>(); });
+  // Only matches entities whose image changed or just loaded, everything else
+  // already has its SpriteRef
+  ecs.system<const ImageAsset, const ImageTile *, const AnimatedTile *,
+             AnimationClocks>("resolveSprite")
+      .kind(flecs::PreStore)
+      .term_at(1)
+      .up<Image>()
+      .with<ImageAsset::IsLoaded>()
+      .up<Image>()
+      .term_at(2)
+      .self()
+      .up<Image>()
+      .term_at(3)
+      .self()
+      .up<Image>()
+      .term_at(4)
+      .singleton()
+      .without<SpriteRef>()
+      .write<SpriteRef>()
+      .each(resolveSprite);
+  ecs.system<AnimationClocks>("advanceAnimationClocks")
+      .kind(flecs::PreStore)
+      .term_at(1)
+      .singleton()
+      .iter(advanceAnimationClocks);
+
+  ecs.system<DrawCommands, const game::Position, const SpriteRef,
+             const AnimationPhase *, const AnimationClocks, FrameClock>(
+         "drawSprites")
+      .kind(flecs::OnStore)
+      .term_at(1)
+      .singleton()
+      .term_at(2)
+      .second<Drawn>()
+      .term_at(5)
+      .singleton()
+      .term_at(6)
+      .singleton()
+      .group_by<Depth>()
+      .each(drawSprite);
+
+  ecs.system<DrawCommands, const game::Position, const SpriteRef>(
+         "drawMailIcon")
+      .kind(flecs::OnStore)
+      .term_at(1)
+      .singleton()
+      .term_at(2)
+      .second<Drawn>()
+      .with<game::Holding>(flecs::Any)
+      .each([](DrawCommands &draw, const game::Position &pos,
+               const SpriteRef &sprite) {
+        draw.blit(sprite.handle, 16, 3 * 16, 16, 16, pos.x, pos.y - 8,
+                  Layer::Overlay);
+      });
+
+  initRenderBackend(ecs);
+}
+
+} // namespace ld53::render
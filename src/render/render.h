@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <flecs.h>
+
+namespace ld53::game {
+struct Room;
+}
+
+namespace ld53::render {
+struct DrawCommands;
+
+constexpr int VIRTUAL_WIDTH = 320;
+constexpr int VIRTUAL_HEIGHT = 240;
+constexpr int MAX_ANIMATION_CLOCKS = 16;
+
+struct ImageAsset {
+  struct IsLoaded {};
+  const char *path;
+  // Backend specific image slot referenced by draw commands
+  int32_t handle{-1};
+};
+
+// Marks a room whose background has been baked into an image by the backend
+struct RenderRoom {
+  int32_t handle{-1};
+};
+
+struct Image {};
+struct DependsOn {};
+// (Position, Drawn) is where an entity is shown this frame, between its world
+// position at the last two ticks
+struct Drawn {};
+
+struct ImageTile {
+  int x{0}, y{0};
+};
+
+struct AnimatedTile {
+  int frames{0};
+  float rate{60.0};
+};
+
+// What an entity's (Image, *) target resolves to through the tileset prefab
+// chain, flattened onto the entity so drawing only reads its own components.
+// Removed whenever the target changes and resolved again once the image has
+// loaded.
+struct SpriteRef {
+  int32_t handle{-1};
+  // Source rect in the image, a zero size draws the whole image
+  int sx{0}, sy{0}, sw{0}, sh{0};
+  // Index into AnimationClocks stepping through frames laid out to the right
+  // of the source rect, -1 if not animated
+  int clock{-1};
+};
+
+// One frame timer per animated tile type, shared by every entity showing that
+// tile so they stay in step. Advanced once per presented frame.
+struct AnimationClocks {
+  struct Clock {
+    flecs::entity_t tile{0};
+    int frames{0};
+    float rate{0.0f};
+    int frame{0};
+    float nextFrame{1.0f};
+  };
+  std::array<Clock, MAX_ANIMATION_CLOCKS> clocks{};
+  int count{0};
+
+  // The clock for a tile type, added the first time the tile is resolved.
+  // -1 once every clock is taken.
+  int find(flecs::entity_t tile, int frames, float rate);
+};
+
+// Shifts an entity's animation by this many frames against its tile's clock
+struct AnimationPhase {
+  int offset{0};
+};
+
+// Sprites are drawn a layer at a time in the order these are registered, so
+// every sprite prefab should pick one
+struct Depth {
+  struct Background {};
+  // Things that stay put in a cell, like mailboxes and gates
+  struct Fixture {};
+  struct Movable {};
+  struct Player {};
+};
+
+// Records the commands that draw a room's tiles at the origin. Returns false
+// if any of the tile images are still loading.
+bool bakeRoom(flecs::world ecs, const game::Room &room, DrawCommands &out);
+
+void initRender(flecs::world &ecs);
+// Implemented by the platform (web/native) backend
+void initRenderBackend(flecs::world &ecs);
+} // namespace ld53::render
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "software.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ld53::render {
+
+constexpr uint32_t ALPHA_MASK = 0xFF000000;
+
+void clearPixels(Pixels &target, uint32_t colour) {
+  std::fill(target.data.begin(), target.data.end(), colour);
+}
+
+// Copies `count` pixels keeping the destination wherever the source is fully
+// transparent. Tiles are 16 wide so the vector loop covers a tile row with
+// four iterations and no tail.
+void blitRow(uint32_t *dst, const uint32_t *src, int count) {
+  int i = 0;
+#if defined(__wasm_simd128__)
+  const v128_t alpha = wasm_i32x4_splat(ALPHA_MASK);
+  const v128_t zero = wasm_i32x4_splat(0);
+  for (; i + 4 <= count; i += 4) {
+    v128_t s = wasm_v128_load(src + i);
+    v128_t d = wasm_v128_load(dst + i);
+    v128_t transparent = wasm_i32x4_eq(wasm_v128_and(s, alpha), zero);
+    wasm_v128_store(dst + i, wasm_v128_bitselect(d, s, transparent));
+  }
+#elif defined(__SSE2__)
+  const __m128i alpha = _mm_set1_epi32((int)ALPHA_MASK);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+    __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, alpha), zero);
+    __m128i out = _mm_or_si128(_mm_and_si128(transparent, d),
+                               _mm_andnot_si128(transparent, s));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), out);
+  }
+#endif
+  for (; i < count; i++) {
+    if (src[i] & ALPHA_MASK)
+      dst[i] = src[i];
+  }
+}
+
+void blitPixels(Pixels &target, const Pixels &src, int sx, int sy, int w,
+                int h, int dx, int dy) {
+  // Clip against both the source and the target
+  if (sx < 0) {
+    w += sx;
+    dx -= sx;
+    sx = 0;
+  }
+  if (sy < 0) {
+    h += sy;
+    dy -= sy;
+    sy = 0;
+  }
+  if (dx < 0) {
+    w += dx;
+    sx -= dx;
+    dx = 0;
+  }
+  if (dy < 0) {
+    h += dy;
+    sy -= dy;
+    dy = 0;
+  }
+  w = std::min({w, src.width - sx, target.width - dx});
+  h = std::min({h, src.height - sy, target.height - dy});
+  if (w <= 0 || h <= 0)
+    return;
+
+  for (int y = 0; y < h; y++) {
+    blitRow(target.row(dy + y) + dx, src.row(sy + y) + sx, w);
+  }
+}
+
+void executeCommands(Pixels &target, const DrawCommand *commands,
+                     size_t count, const std::vector<Pixels> &images) {
+  for (size_t i = 0; i < count; i++) {
+    auto &cmd = commands[i];
+    if (cmd.image < 0 || (size_t)cmd.image >= images.size())
+      continue;
+    auto &image = images[cmd.image];
+    if (image.data.empty())
+      continue;
+    if (cmd.sw == 0) {
+      blitPixels(target, image, 0, 0, image.width, image.height, cmd.dx,
+                 cmd.dy);
+    } else {
+      blitPixels(target, image, cmd.sx, cmd.sy, cmd.sw, cmd.sh, cmd.dx,
+                 cmd.dy);
+    }
+  }
+}
+
+// Integer scales replicate each source pixel `scale` times, splatting it
+// across a vector at a time. Stores may spill into the next pixel's span
+// which is overwritten straight after, the tail is done one at a time so
+// nothing is written past the end of the row.
+void upscaleRowInteger(uint32_t *dst, const uint32_t *src, int count,
+                       int scale) {
+  int i = 0;
+#if defined(__wasm_simd128__) || defined(__SSE2__)
+  int padded = (scale + 3) & ~3;
+  for (; i * scale + padded <= count * scale; i++) {
+    uint32_t *out = dst + i * scale;
+#if defined(__wasm_simd128__)
+    v128_t v = wasm_i32x4_splat(src[i]);
+    for (int j = 0; j < scale; j += 4)
+      wasm_v128_store(out + j, v);
+#else
+    __m128i v = _mm_set1_epi32((int)src[i]);
+    for (int j = 0; j < scale; j += 4)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), v);
+#endif
+  }
+#endif
+  for (; i < count; i++) {
+    std::fill_n(dst + i * scale, scale, src[i]);
+  }
+}
+
+void upscaleNearest(const Pixels &src, Pixels &target) {
+  clearPixels(target, ALPHA_MASK);
+  if (src.width == 0 || src.height == 0)
+    return;
+
+  // Same fit as the canvas backend's endFrame
+  auto targetAspect = (float)src.width / (float)src.height;
+  auto currentAspect = (float)target.width / (float)target.height;
+  float scale = 1.0;
+  if (currentAspect > targetAspect) {
+    scale = (float)target.height / (float)src.height;
+  } else {
+    scale = (float)target.width / (float)src.width;
+  }
+  int width = std::min((int)(src.width * scale), target.width);
+  int height = std::min((int)(src.height * scale), target.height);
+  int ox = (target.width - width) / 2;
+  int oy = (target.height - height) / 2;
+  if (width <= 0 || height <= 0)
+    return;
+
+  bool integer = width % src.width == 0 && height % src.height == 0 &&
+                 width / src.width == height / src.height;
+  std::vector<int> columns;
+  if (!integer) {
+    columns.resize(width);
+    for (int x = 0; x < width; x++)
+      columns[x] = x * src.width / width;
+  }
+
+  int lastRow = -1;
+  for (int y = 0; y < height; y++) {
+    int sy = y * src.height / height;
+    auto out = target.row(oy + y) + ox;
+    if (sy == lastRow) {
+      // Repeated source rows are a straight copy of the row above
+      memcpy(out, out - target.width, width * sizeof(uint32_t));
+      continue;
+    }
+    lastRow = sy;
+
+    auto in = src.row(sy);
+    if (integer) {
+      upscaleRowInteger(out, in, src.width, width / src.width);
+    } else {
+      for (int x = 0; x < width; x++)
+        out[x] = in[columns[x]];
+    }
+  }
+}
+
+} // namespace ld53::render
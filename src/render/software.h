@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "commands.h"
+
+namespace ld53::render {
+
+// RGBA8 pixels, byte order matches canvas ImageData so a buffer can be
+// handed to putImageData as is.
+struct Pixels {
+  int width{0}, height{0};
+  std::vector<uint32_t> data;
+
+  void resize(int w, int h) {
+    width = w;
+    height = h;
+    data.resize((size_t)w * h);
+  }
+  uint32_t *row(int y) { return data.data() + (size_t)y * width; }
+  const uint32_t *row(int y) const { return data.data() + (size_t)y * width; }
+};
+
+void clearPixels(Pixels &target, uint32_t colour);
+
+// Alpha tested copy, any pixel with a zero alpha is skipped. Clips against
+// the target, scaling is not supported.
+void blitPixels(Pixels &target, const Pixels &src, int sx, int sy, int w,
+                int h, int dx, int dy);
+
+// Runs a command buffer against `images`, indexed by image handle. Commands
+// referencing a missing image are skipped.
+void executeCommands(Pixels &target, const DrawCommand *commands,
+                     size_t count, const std::vector<Pixels> &images);
+
+// Nearest neighbour scale of `src` to fit centered inside `target`,
+// letterboxed with black in the same way as the canvas backend.
+void upscaleNearest(const Pixels &src, Pixels &target);
+
+} // namespace ld53::render
@@ -0,0 +1,52 @@
+#include "solver.h"
+
+#include "game/common.h"
+
+namespace ld53::solver {
+
+bool extractPuzzle(flecs::entity room, Puzzle &out) {
+  auto objects = room.get<game::RoomObjects>();
+  if (!objects)
+    return false;
+  for (int y = 0; y < game::ROOM_HEIGHT; y++) {
+    for (int x = 0; x < game::ROOM_WIDTH; x++) {
+      auto &tile = out.tiles[x + y * game::ROOM_WIDTH];
+      if (objects->is_solid(x, y, false))
+        tile = game::TileType::Solid;
+      else if (objects->is_solid(x, y, true))
+        tile = game::TileType::SolidPlayer;
+    }
+  }
+  out.player = game::PLAYER_START_X + game::PLAYER_START_Y * game::ROOM_WIDTH;
+  if (auto circuit = room.get<game::Circuit>())
+    out.circuit = *circuit;
+
+  room.children([&](flecs::entity child) {
+    auto pos = child.get<game::GridPosition>();
+    if (!pos)
+      return;
+    auto cell = (uint16_t)(pos->x + pos->y * game::ROOM_WIDTH);
+    auto node = child.get<game::CircuitNode>();
+    auto type = child.get<game::TileType>();
+    if (child.has<game::Pushable>()) {
+      out.boxes.push_back(cell);
+    } else if (child.has<game::MailObject>()) {
+      out.mail.push_back(cell);
+    } else if (child.has<game::MailBox>() &&
+               !child.has<game::MailBox::Full>()) {
+      out.mailboxes.push_back(cell);
+    } else if (child.has<game::WeightActivated>()) {
+      if (node)
+        out.plates.push_back({cell, node->index});
+    } else if (child.has<game::Gate>()) {
+      out.gates.push_back({cell, node ? node->index : game::NO_NODE,
+                           type && *type == game::TileType::None});
+    } else if (type && *type != game::TileType::None &&
+               out.tiles[cell] != game::TileType::Solid) {
+      out.tiles[cell] = *type;
+    }
+  });
+  return true;
+}
+
+} // namespace ld53::solver
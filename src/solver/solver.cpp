@@ -0,0 +1,501 @@
+#include "solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace ld53::solver {
+
+namespace {
+
+using game::ROOM_CELLS;
+using game::ROOM_HEIGHT;
+using game::ROOM_WIDTH;
+using game::TileType;
+
+struct State {
+  uint16_t player;
+  uint8_t holding;
+  uint32_t full;
+  uint64_t latches;
+  // Sorted so identical boxes/mail in swapped places are the same state,
+  // unused entries are NO_CELL and sort last
+  std::array<uint16_t, MAX_BOXES> boxes;
+  std::array<uint16_t, MAX_MAIL> mail;
+};
+
+struct Node {
+  State state;
+  uint32_t parent;
+  Action action;
+};
+
+struct Zobrist {
+  std::array<uint64_t, ROOM_CELLS> player, box, mail;
+  std::array<uint64_t, MAX_MAILBOXES> full;
+  std::array<uint64_t, MAX_LATCHES> latch;
+  uint64_t holding;
+
+  Zobrist() {
+    std::mt19937_64 rng{0x1d53};
+    for (auto *keys : {&player, &box, &mail})
+      for (auto &k : *keys)
+        k = rng();
+    for (auto &k : full)
+      k = rng();
+    for (auto &k : latch)
+      k = rng();
+    holding = rng();
+  }
+
+  uint64_t hash(const State &s) const {
+    uint64_t h = player[s.player];
+    if (s.holding)
+      h ^= holding;
+    for (auto b : s.boxes)
+      if (b != NO_CELL)
+        h ^= box[b];
+    for (auto m : s.mail)
+      if (m != NO_CELL)
+        h ^= mail[m];
+    for (uint32_t f = s.full; f; f &= f - 1)
+      h ^= full[__builtin_ctz(f)];
+    for (uint64_t l = s.latches; l; l &= l - 1)
+      h ^= latch[__builtin_ctzll(l)];
+    // Zero marks an empty table slot
+    return h ? h : 1;
+  }
+};
+
+// Open addressed set of state hashes. Inserting claims a slot with a single
+// compare-and-swap so threads never wait on each other.
+class TranspositionTable {
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  uint64_t mask;
+  std::atomic<uint64_t> count{0};
+
+public:
+  explicit TranspositionTable(int bits)
+      : slots(new std::atomic<uint64_t>[size_t(1) << bits]),
+        mask((uint64_t(1) << bits) - 1) {
+    for (uint64_t i = 0; i <= mask; i++)
+      slots[i].store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t size() const { return count.load(std::memory_order_relaxed); }
+  bool full() const { return size() > mask - mask / 8; }
+
+  // True if the key was not in the table yet. Once the table is mostly full
+  // nothing new goes in so the search runs dry instead of probing forever.
+  bool insert(uint64_t key) {
+    if (full())
+      return false;
+    for (uint64_t i = key & mask;; i = (i + 1) & mask) {
+      auto current = slots[i].load(std::memory_order_relaxed);
+      if (current == key)
+        return false;
+      if (current == 0) {
+        if (slots[i].compare_exchange_strong(current, key,
+                                             std::memory_order_relaxed)) {
+          count.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+        if (current == key)
+          return false;
+      }
+    }
+  }
+};
+
+// A thread's share of the frontier packed as begin/end into one word. The
+// owner takes chunks off the front, thieves take the back half.
+class WorkRange {
+  std::atomic<uint64_t> range{0};
+
+  static uint64_t pack(uint32_t begin, uint32_t end) {
+    return (uint64_t)begin << 32 | end;
+  }
+
+public:
+  static constexpr uint32_t CHUNK = 64;
+
+  void reset(uint32_t begin, uint32_t end) { range.store(pack(begin, end)); }
+
+  bool take(uint32_t &begin, uint32_t &end) {
+    auto v = range.load();
+    while (true) {
+      uint32_t b = v >> 32, e = (uint32_t)v;
+      if (b >= e)
+        return false;
+      uint32_t nb = std::min(b + CHUNK, e);
+      if (range.compare_exchange_weak(v, pack(nb, e))) {
+        begin = b;
+        end = nb;
+        return true;
+      }
+    }
+  }
+
+  bool steal(uint32_t &begin, uint32_t &end) {
+    auto v = range.load();
+    while (true) {
+      uint32_t b = v >> 32, e = (uint32_t)v;
+      if (b >= e || e - b < 2 * CHUNK)
+        return false;
+      uint32_t mid = b + (e - b) / 2;
+      if (range.compare_exchange_weak(v, pack(b, mid))) {
+        begin = mid;
+        end = e;
+        return true;
+      }
+    }
+  }
+};
+
+int step(int dir) {
+  switch (dir) {
+  case 0:
+    return -ROOM_WIDTH;
+  case 1:
+    return ROOM_WIDTH;
+  case 2:
+    return -1;
+  default:
+    return 1;
+  }
+}
+
+bool inRoom(int cell, int dir) {
+  int x = cell % ROOM_WIDTH, y = cell / ROOM_WIDTH;
+  switch (dir) {
+  case 0:
+    return y > 0;
+  case 1:
+    return y < ROOM_HEIGHT - 1;
+  case 2:
+    return x > 0;
+  default:
+    return x < ROOM_WIDTH - 1;
+  }
+}
+
+// Applies the game's rules to a state one action at a time. Gates are
+// settled between steps as the game has several frames between moving
+// cells for the circuit to catch up.
+class Simulator {
+  const Puzzle &puzzle;
+  std::array<uint8_t, ROOM_CELLS> mailboxAt;
+  std::vector<uint16_t> latchNodes;
+  std::array<bool, game::MAX_CIRCUIT_NODES> values{};
+
+public:
+  explicit Simulator(const Puzzle &puzzle) : puzzle(puzzle) {
+    mailboxAt.fill(0xFF);
+    for (size_t i = 0; i < puzzle.mailboxes.size(); i++)
+      mailboxAt[puzzle.mailboxes[i]] = (uint8_t)i;
+    for (int i = 0; i < puzzle.circuit.nodeCount; i++) {
+      if (puzzle.circuit.nodes[i].op == game::LogicOp::Latch)
+        latchNodes.push_back((uint16_t)i);
+    }
+  }
+
+  bool supported() const {
+    return puzzle.boxes.size() <= MAX_BOXES &&
+           puzzle.mail.size() <= MAX_MAIL &&
+           puzzle.mailboxes.size() <= MAX_MAILBOXES &&
+           latchNodes.size() <= MAX_LATCHES;
+  }
+
+  State initial() {
+    State s{};
+    s.player = puzzle.player;
+    s.boxes.fill(NO_CELL);
+    s.mail.fill(NO_CELL);
+    std::copy(puzzle.boxes.begin(), puzzle.boxes.end(), s.boxes.begin());
+    std::copy(puzzle.mail.begin(), puzzle.mail.end(), s.mail.begin());
+    std::sort(s.boxes.begin(), s.boxes.end());
+    std::sort(s.mail.begin(), s.mail.end());
+    settle(s);
+    return s;
+  }
+
+  bool solved(const State &s) const {
+    auto all = puzzle.mailboxes.size() == 32
+                   ? 0xFFFFFFFFu
+                   : (1u << puzzle.mailboxes.size()) - 1;
+    return s.full == all;
+  }
+
+  // Returns false if the action leaves the state unchanged
+  bool apply(const State &from, Action action, State &out) {
+    out = from;
+    settle(out);
+    int a = (int)action;
+    if (a < 4)
+      return walk(out, a);
+    return out.holding && toss(out, a - 4);
+  }
+
+private:
+  bool hasBox(const State &s, int cell) const {
+    return std::find(s.boxes.begin(), s.boxes.end(), cell) != s.boxes.end();
+  }
+
+  // Recomputes the circuit from what is weighing down each plate, latches
+  // that came on are kept in the state. Nodes are sorted so one pass does.
+  void settle(State &s, int flying = NO_CELL) {
+    for (auto &plate : puzzle.plates) {
+      int c = plate.cell;
+      values[plate.node] =
+          s.player == c || flying == c || hasBox(s, c) ||
+          std::find(s.mail.begin(), s.mail.end(), c) != s.mail.end();
+    }
+    auto &circuit = puzzle.circuit;
+    int latch = 0;
+    for (int i = 0; i < circuit.nodeCount; i++) {
+      auto &n = circuit.nodes[i];
+      if (n.op == game::LogicOp::Input)
+        continue;
+      bool isLatch = n.op == game::LogicOp::Latch;
+      bool current = isLatch && (s.latches >> latch & 1);
+      int on = 0;
+      for (int j = 0; j < n.inputCount; j++)
+        on += values[circuit.inputs[n.firstInput + j]];
+      values[i] = game::Circuit::apply(n.op, current, on, n.inputCount);
+      if (isLatch) {
+        if (values[i])
+          s.latches |= uint64_t(1) << latch;
+        latch++;
+      }
+    }
+  }
+
+  bool gateClosed(int cell) const {
+    for (auto &gate : puzzle.gates) {
+      if (gate.cell != cell)
+        continue;
+      bool open = gate.node == game::NO_NODE ? gate.open : values[gate.node];
+      if (!open)
+        return true;
+    }
+    return false;
+  }
+
+  bool solid(const State &s, int cell, bool isPlayer) const {
+    auto tile = puzzle.tiles[cell];
+    if (tile == TileType::Solid || hasBox(s, cell) || gateClosed(cell))
+      return true;
+    return isPlayer &&
+           (tile == TileType::SolidPlayer || mailboxAt[cell] != 0xFF);
+  }
+
+  static void place(std::array<uint16_t, MAX_BOXES> &boxes, int from,
+                    int to) {
+    *std::find(boxes.begin(), boxes.end(), from) = (uint16_t)to;
+    std::sort(boxes.begin(), boxes.end());
+  }
+
+  bool walk(State &s, int dir) {
+    if (!inRoom(s.player, dir))
+      return false;
+    int target = s.player + step(dir);
+    bool changed = false;
+
+    // The push happens before the player is checked, the player only
+    // follows once the boxes are out of the way. A line of boxes moves
+    // together if the cell past the last one is free.
+    int end = target;
+    while (hasBox(s, end) && inRoom(end, dir))
+      end += step(dir);
+    if (end != target && !hasBox(s, end) && !solid(s, end, false)) {
+      for (int cell = end - step(dir);; cell -= step(dir)) {
+        place(s.boxes, cell, cell + step(dir));
+        if (cell == target)
+          break;
+      }
+      settle(s);
+      changed = true;
+    }
+    // Mail is picked up from the cell the player tried to enter even if
+    // they end up blocked
+    if (!s.holding) {
+      auto it = std::find(s.mail.begin(), s.mail.end(), target);
+      if (it != s.mail.end()) {
+        *it = NO_CELL;
+        std::sort(s.mail.begin(), s.mail.end());
+        s.holding = 1;
+        settle(s);
+        changed = true;
+      }
+    }
+    if (!solid(s, target, true)) {
+      s.player = (uint16_t)target;
+      settle(s);
+      changed = true;
+    }
+    return changed;
+  }
+
+  bool toss(State &s, int dir) {
+    int cell = s.player;
+    if (!inRoom(cell, dir) || solid(s, cell + step(dir), false))
+      return false;
+    s.holding = 0;
+    while (true) {
+      cell += step(dir);
+      settle(s, cell);
+      auto box = mailboxAt[cell];
+      if (box != 0xFF && !(s.full >> box & 1)) {
+        s.full |= 1u << box;
+        settle(s);
+        return true;
+      }
+      if (!inRoom(cell, dir) || solid(s, cell + step(dir), false))
+        break;
+    }
+    *std::find(s.mail.begin(), s.mail.end(), NO_CELL) = (uint16_t)cell;
+    std::sort(s.mail.begin(), s.mail.end());
+    settle(s);
+    return true;
+  }
+};
+
+} // namespace
+
+const char *actionName(Action action) {
+  switch (action) {
+  case Action::Up:
+    return "U";
+  case Action::Down:
+    return "D";
+  case Action::Left:
+    return "L";
+  case Action::Right:
+    return "R";
+  case Action::ThrowUp:
+    return "^";
+  case Action::ThrowDown:
+    return "v";
+  case Action::ThrowLeft:
+    return "<";
+  case Action::ThrowRight:
+    return ">";
+  }
+  return "?";
+}
+
+Solution solve(const Puzzle &puzzle, const SolveOptions &options) {
+  Solution solution;
+  auto start = std::chrono::steady_clock::now();
+  int threads = std::max(1, options.threads);
+
+  Simulator root{puzzle};
+  if (!root.supported()) {
+    printf("Room is too large for the solver\n");
+    return solution;
+  }
+  Zobrist zobrist;
+  TranspositionTable table{options.tableBits};
+
+  std::vector<std::vector<Node>> levels;
+  levels.push_back({{root.initial(), 0, Action::Up}});
+  table.insert(zobrist.hash(levels[0][0].state));
+
+  std::atomic<uint64_t> expanded{0};
+  int64_t goal = root.solved(levels[0][0].state) ? 0 : -1;
+  std::vector<WorkRange> ranges(threads);
+  std::vector<std::vector<Node>> outputs(threads);
+
+  for (int depth = 0; goal < 0 && depth < options.maxDepth; depth++) {
+    auto &frontier = levels.back();
+    if (frontier.empty() || table.full())
+      break;
+
+    uint32_t count = (uint32_t)frontier.size();
+    for (int t = 0; t < threads; t++) {
+      ranges[t].reset((uint32_t)((uint64_t)count * t / threads),
+                      (uint32_t)((uint64_t)count * (t + 1) / threads));
+      outputs[t].clear();
+    }
+    std::atomic<int64_t> found{-1};
+
+    auto work = [&](int self) {
+      Simulator sim{puzzle};
+      auto &out = outputs[self];
+      uint64_t local = 0;
+      uint32_t begin, end;
+      while (found.load(std::memory_order_relaxed) < 0) {
+        if (!ranges[self].take(begin, end)) {
+          bool stole = false;
+          for (int i = 1; i < threads && !stole; i++)
+            stole = ranges[(self + i) % threads].steal(begin, end);
+          if (!stole)
+            break;
+          ranges[self].reset(begin, end);
+          continue;
+        }
+        for (uint32_t i = begin; i < end; i++) {
+          local++;
+          for (int a = 0; a < 8; a++) {
+            State next;
+            if (!sim.apply(frontier[i].state, (Action)a, next))
+              continue;
+            if (!table.insert(zobrist.hash(next)))
+              continue;
+            out.push_back({next, i, (Action)a});
+            if (sim.solved(next)) {
+              int64_t none = -1;
+              found.compare_exchange_strong(
+                  none, (int64_t)self << 32 | (out.size() - 1));
+            }
+          }
+        }
+      }
+      expanded.fetch_add(local);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++)
+      pool.emplace_back(work, t);
+    work(0);
+    for (auto &thread : pool)
+      thread.join();
+
+    std::vector<Node> next;
+    size_t offset = 0;
+    auto winner = found.load();
+    for (int t = 0; t < threads; t++) {
+      if (winner >= 0 && (winner >> 32) == t)
+        goal = (int64_t)(offset + (uint32_t)winner);
+      offset += outputs[t].size();
+      next.insert(next.end(), outputs[t].begin(), outputs[t].end());
+    }
+    levels.push_back(std::move(next));
+  }
+
+  if (goal >= 0) {
+    solution.solved = true;
+    uint32_t index = (uint32_t)goal;
+    for (size_t depth = levels.size() - 1; depth > 0; depth--) {
+      auto &node = levels[depth][index];
+      solution.moves.push_back(node.action);
+      index = node.parent;
+    }
+    std::reverse(solution.moves.begin(), solution.moves.end());
+  } else if (table.full()) {
+    printf("Transposition table full, try a larger --table-bits\n");
+  }
+
+  solution.states = table.size();
+  solution.nodes = expanded.load();
+  solution.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  return solution;
+}
+
+} // namespace ld53::solver
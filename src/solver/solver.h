@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "game/circuit.h"
+#include "game/room.h"
+
+namespace ld53::solver {
+
+constexpr int MAX_BOXES = 16;
+constexpr int MAX_MAIL = 8;
+constexpr int MAX_MAILBOXES = 32;
+constexpr int MAX_LATCHES = 64;
+constexpr uint16_t NO_CELL = 0xFFFF;
+
+enum class Action : uint8_t {
+  Up,
+  Down,
+  Left,
+  Right,
+  ThrowUp,
+  ThrowDown,
+  ThrowLeft,
+  ThrowRight,
+};
+
+struct Gate {
+  uint16_t cell;
+  // Node deciding whether the gate is open, gates without one never change
+  uint16_t node;
+  bool open;
+};
+
+struct Plate {
+  uint16_t cell;
+  uint16_t node;
+};
+
+// Everything about a room the solver needs, pulled out of a room prefab so
+// the search never touches the ECS
+struct Puzzle {
+  // Static tiles only, objects are tracked separately
+  std::array<game::TileType, game::ROOM_CELLS> tiles{};
+  uint16_t player{0};
+  std::vector<uint16_t> boxes;
+  std::vector<uint16_t> mail;
+  std::vector<uint16_t> mailboxes;
+  std::vector<Plate> plates;
+  std::vector<Gate> gates;
+  game::Circuit circuit;
+};
+
+struct Solution {
+  bool solved{false};
+  std::vector<Action> moves;
+  // Unique states reached and states expanded
+  uint64_t states{0};
+  uint64_t nodes{0};
+  double seconds{0};
+};
+
+struct SolveOptions {
+  int threads{1};
+  int maxDepth{1000};
+  // log2 of the transposition table's entry count
+  int tableBits{22};
+};
+
+// Reads a room prefab's tiles, objects and circuit
+bool extractPuzzle(flecs::entity room, Puzzle &out);
+
+// Breadth first search over player moves and throws for the fewest actions
+// that fill every mailbox. Each depth is expanded in parallel with the
+// frontier split between threads that steal from each other when they run
+// out, states are deduplicated by Zobrist hash in a lock-free table.
+Solution solve(const Puzzle &puzzle, const SolveOptions &options);
+
+const char *actionName(Action action);
+
+} // namespace ld53::solver
@@ -1,88 +1,74 @@
-#include "input.h"
+#include "input/input.h"
 
+#include <emscripten.h>
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
-#include <optional>
 
+#include "game/common.h"
+#include "loop.h"
 #include "main.h"
 
 namespace ld53::input {
 
-std::optional<InputType> mapKey(std::string_view key) {
-  InputType type;
-  if (key == "KeyW" || key == "ArrowUp")
-    type = InputType::Up;
-  else if (key == "KeyS" || key == "ArrowDown")
-    type = InputType::Down;
-  else if (key == "KeyA" || key == "ArrowLeft")
-    type = InputType::Left;
-  else if (key == "KeyD" || key == "ArrowRight")
-    type = InputType::Right;
-  else if (key == "KeyF")
-    type = InputType::Fire;
-  else if (key == "KeyR")
-    type = InputType::Restart;
-  else
-    return {};
-
-  return {type};
-}
-
-bool event_keyup(emscripten::val event) {
-  auto key = event["code"].as<std::string>();
-
-  auto type = mapKey(key);
-  if (!type)
-    return false;
-
-  gWorld->entity().emplace<InputData>(false, *type);
-  return true;
+// Called from the key listeners with the key already mapped to an InputType
+bool push_input(int type, bool pressed, double time) {
+  return inputQueue().push({(uint32_t)time, {pressed, (InputType)type}});
 }
-bool event_keydown(emscripten::val event) {
-  auto key = event["code"].as<std::string>();
 
-  auto type = mapKey(key);
-  if (!type)
-    return false;
+// Key codes are mapped on the JS side so no strings cross into wasm. The
+// values match InputType.
+static_assert((int)InputType::Up == 0 && (int)InputType::Restart == 5 &&
+              (int)InputType::Undo == 6);
+EM_JS(void, capture_keys, (bool enable), {
+  if (!Module.ld53Keys) {
+    var codes = {
+      KeyW : 0, ArrowUp : 0,
+      KeyS : 1, ArrowDown : 1,
+      KeyA : 2, ArrowLeft : 2,
+      KeyD : 3, ArrowRight : 3,
+      KeyF : 4,
+      KeyR : 5,
+      KeyZ : 6, Backspace : 6
+    };
+    var listener = function(pressed) {
+      return function(event) {
+        // Not a game input, so it is never recorded
+        if (pressed && event.code == "Backquote" && !event.repeat)
+          Module.toggle_profiler();
+        var type = codes[event.code];
+        if (type !== undefined)
+          Module.push_input(type, pressed, event.timeStamp);
+      };
+    };
+    Module.ld53Keys = {up : listener(false), down : listener(true)};
+  }
+  var action = enable ? "addEventListener" : "removeEventListener";
+  window[action]("keyup", Module.ld53Keys.up);
+  window[action]("keydown", Module.ld53Keys.down);
+});
 
-  gWorld->entity().emplace<InputData>(true, *type);
-  return true;
+// The session so far in the binary input log format, the native build can
+// replay it with --replay
+emscripten::val input_log() {
+  auto recording = gWorld->get_mut<InputRecording>();
+  recording->log.frames = currentTick(*gWorld);
+  recording->log.hash = game::hashGameState(*gWorld);
+  auto data = encodeInputLog(recording->log);
+  return emscripten::val::global("Uint8Array")
+      .new_(emscripten::typed_memory_view(data.size(), data.data()));
 }
 
 // Fake sokol for flecs explorer support
-void sokol_capture_keyboard_events(bool enable) {
-  auto window = emscripten::val::global("window");
-  const char *action = enable ? "addEventListener" : "removeEventListener";
-
-  window.call<void>(action, emscripten::val("keyup"),
-                    emscripten::val::module_property("event_keyup"));
-  window.call<void>(action, emscripten::val("keydown"),
-                    emscripten::val::module_property("event_keydown"));
-}
+void sokol_capture_keyboard_events(bool enable) { capture_keys(enable); }
 
 EMSCRIPTEN_BINDINGS(ld53) {
   emscripten::function("sokol_capture_keyboard_events",
                        sokol_capture_keyboard_events);
-  emscripten::function("event_keyup", event_keyup);
-  emscripten::function("event_keydown", event_keydown);
+  emscripten::function("push_input", push_input);
+  emscripten::function("input_log", input_log);
 }
 
-void initInput(flecs::world &ecs) {
+void initInputBackend(flecs::world &ecs) {
   sokol_capture_keyboard_events(true);
-  flecs::enum_type<InputType>(ecs);
-  ecs.component<InputType>()
-      .constant("Up", (int32_t)InputType::Up)
-      .constant("Down", (int32_t)InputType::Down)
-      .constant("Left", (int32_t)InputType::Left)
-      .constant("Right", (int32_t)InputType::Right)
-      .constant("Fire", (int32_t)InputType::Fire)
-      .constant("Restart", (int32_t)InputType::Restart);
-  ecs.component<InputData>().member<bool>("pressed").member<InputType>("type");
-
-  ecs.system<>("cleanupInputData")
-      .with<InputData>()
-      .inout_none()
-      .kind(flecs::PostFrame)
-      .each([](flecs::entity e) { e.destruct(); });
 }
-} // namespace ld53::input
\ No newline at end of file
+} // namespace ld53::input
@@ -0,0 +1,110 @@
+
+#include <emscripten.h>
+#include <emscripten/bind.h>
+#include <emscripten/val.h>
+#include <ctime>
+#include <flecs.h>
+#include <string>
+
+#include <vector>
+
+#include "assets.h"
+#include "game/common.h"
+#include "game/room.h"
+#include "input/input.h"
+#include "loop.h"
+#include "main.h"
+#include "profile/profile.h"
+#include "render/render.h"
+
+flecs::world *gWorld = nullptr;
+
+// Called on every animation frame, at whatever rate the display runs at.
+// Ticks are caught up on first so a slow frame skips drawing, not gameplay.
+void main_loop(void *ecsRaw) {
+  flecs::world ecs{static_cast<flecs::world_t *>(ecsRaw)};
+  ld53::advance(ecs, emscripten_get_now() / 1000.0);
+}
+
+EM_JS(void, fetch_level_pack, (const char *url), {
+  fetch(UTF8ToString(url))
+      .then(function(response) {
+        if (!response.ok)
+          throw new Error(response.statusText);
+        return response.arrayBuffer();
+      })
+      .then(function(buffer) { Module.on_level_pack(new Uint8Array(buffer)); })
+      .catch(function(error) { console.error("Level pack", error); });
+});
+
+// The game only starts ticking once the pack is here, so tick numbers line
+// up with native runs that map it before the first tick
+void on_level_pack(emscripten::val bytes) {
+  static std::vector<uint8_t> pack;
+  pack = emscripten::convertJSArrayToNumberVector<uint8_t>(bytes);
+  if (!ld53::game::setLevelPack(*gWorld, pack.data(), pack.size())) {
+    printf("Invalid level pack\n");
+    return;
+  }
+  emscripten_set_main_loop_arg(main_loop, gWorld->c_ptr(), 0, 0);
+}
+
+EMSCRIPTEN_BINDINGS(ld53) {
+  emscripten::function("on_level_pack", on_level_pack);
+}
+
+int main_init(ecs_world_t *world, ecs_app_desc_t *desc) {
+  fetch_level_pack(ld53::locateFile("levels.pack").c_str());
+  return 0;
+}
+
+int main(void) {
+  printf("Start\n");
+  // Nothing draws from rand() since maps are baked at compile time, it is
+  // still seeded and recorded so replays hold if that changes
+  auto seed = (uint32_t)time(nullptr);
+  srand(seed);
+  gWorld = new flecs::world{};
+
+#ifdef LD53_DEBUG_TOOLS
+  gWorld->import <flecs::monitor>();
+#endif
+  ld53::initLoop(*gWorld);
+  ld53::assets::loadAssets(*gWorld);
+  ld53::render::initRender(*gWorld);
+  ld53::game::initGame(*gWorld);
+  ld53::input::initInput(*gWorld);
+  ld53::input::startRecording(*gWorld, seed);
+  // The profiler is installed the first time its HUD is shown
+
+  ecs_app_set_run_action(main_init);
+
+#ifdef LD53_DEBUG_TOOLS
+  return gWorld->app().enable_rest().run();
+#else
+  return gWorld->app().run();
+#endif
+}
+
+namespace ld53 {
+std::string findLoc() {
+  auto params =
+      emscripten::val::global("URLSearchParams")
+          .new_(emscripten::val::global("document")["location"]["search"]);
+  auto wasmUrl = params.call<emscripten::val>("get", emscripten::val("wasm"));
+  if (!wasmUrl.isString()) {
+    printf("Missing wasm url\n");
+    return "./data/";
+  }
+  auto wasm = wasmUrl.as<std::string>();
+  auto pos = wasm.find_last_of('/');
+  auto url = wasm.substr(0, pos) + "/../data/";
+  printf("URL: %s\n", url.c_str());
+  return url;
+}
+
+std::string locateFile(const char *path) {
+  static std::string scriptLoc = findLoc();
+  return scriptLoc + path;
+}
+} // namespace ld53
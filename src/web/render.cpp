@@ -1,18 +1,25 @@
+#include "render/render.h"
 
-#include "render.h"
-
+#include <algorithm>
+#include <cstdio>
+#include <emscripten.h>
 #include <emscripten/bind.h>
 #include <emscripten/html5.h>
 #include <emscripten/val.h>
+#include <vector>
 
 #include "assets.h"
 #include "game/common.h"
 #include "game/room.h"
+#include "loop.h"
 #include "main.h"
+#include "profile/profile.h"
+#include "render/commands.h"
+#ifdef LD53_SOFTWARE_RENDER
+#include "render/software.h"
+#endif
 
 namespace ld53::render {
-constexpr int VIRTUAL_WIDTH = 320;
-constexpr int VIRTUAL_HEIGHT = 240;
 
 struct Renderer {
   emscripten::val canvas;
@@ -21,16 +28,155 @@ struct Renderer {
   emscripten::val ctx;
 
   int width, height;
+
+  // Images and baked room canvases indexed by draw command handle
+  emscripten::val images;
+  int32_t nextHandle{0};
+
+#ifdef LD53_SOFTWARE_RENDER
+  // CPU side copies of `images`, the frame is composed into `framebuffer`
+  // and scaled into `screen` which is handed to the canvas in one go.
+  std::vector<Pixels> pixels;
+  Pixels framebuffer;
+  Pixels screen;
+#endif
 };
 
 struct HTMLImage {
-  struct IsLoaded {};
   emscripten::val image;
 };
 
-struct RenderRoom {
-  emscripten::val canvas;
-};
+// Replays a command buffer straight out of wasm memory so a whole frame only
+// crosses into JS once.
+EM_JS(void, draw_commands,
+      (emscripten::EM_VAL ctxHandle, emscripten::EM_VAL imagesHandle,
+       const int32_t *commands, int count, int stride),
+      {
+        const ctx = Emval.toValue(ctxHandle);
+        const images = Emval.toValue(imagesHandle);
+        const data =
+            HEAP32.subarray(commands >> 2, (commands >> 2) + count * stride);
+        for (let i = 0; i < data.length; i += stride) {
+          const image = images[data[i]];
+          if (!image)
+            continue;
+          if (data[i + 3] == 0) {
+            ctx.drawImage(image, data[i + 5], data[i + 6]);
+          } else {
+            ctx.drawImage(image, data[i + 1], data[i + 2], data[i + 3],
+                          data[i + 4], data[i + 5], data[i + 6], data[i + 7],
+                          data[i + 8]);
+          }
+        }
+      });
+
+void drawCommands(emscripten::val &ctx, const Renderer &renderer,
+                  const DrawCommands &draw) {
+  draw_commands(ctx.as_handle(), renderer.images.as_handle(),
+                reinterpret_cast<const int32_t *>(draw.commands.data()),
+                draw.commands.size(), DRAW_COMMAND_INTS);
+}
+
+#ifdef LD53_SOFTWARE_RENDER
+Pixels &pixelsFor(Renderer &renderer, int32_t handle) {
+  if ((size_t)handle >= renderer.pixels.size())
+    renderer.pixels.resize(handle + 1);
+  return renderer.pixels[handle];
+}
+
+// Copies a loaded image's pixels into wasm memory, once per image
+void readPixels(Renderer &renderer, int32_t handle, emscripten::val image) {
+  int width = image["naturalWidth"].as<int>();
+  int height = image["naturalHeight"].as<int>();
+  auto document = emscripten::val::global("document");
+  auto canvas = document.call<emscripten::val>("createElement",
+                                               emscripten::val("canvas"));
+  canvas.set("width", width);
+  canvas.set("height", height);
+  auto ctx = canvas.call<emscripten::val>("getContext", emscripten::val("2d"));
+  ctx.call<void>("drawImage", image, 0, 0);
+  auto data = ctx.call<emscripten::val>("getImageData", 0, 0, width,
+                                        height)["data"];
+
+  auto &pixels = pixelsFor(renderer, handle);
+  pixels.resize(width, height);
+  emscripten::val(emscripten::typed_memory_view(
+                      pixels.data.size() * sizeof(uint32_t),
+                      reinterpret_cast<uint8_t *>(pixels.data.data())))
+      .call<void>("set", data);
+}
+
+void presentPixels(Renderer &renderer) {
+  renderer.screen.resize(renderer.width, renderer.height);
+  upscaleNearest(renderer.framebuffer, renderer.screen);
+
+  auto view = emscripten::val(emscripten::typed_memory_view(
+      renderer.screen.data.size() * sizeof(uint32_t),
+      reinterpret_cast<uint8_t *>(renderer.screen.data.data())));
+  auto bytes = emscripten::val::global("Uint8ClampedArray")
+                   .new_(view["buffer"], view["byteOffset"], view["length"]);
+  auto image = emscripten::val::global("ImageData")
+                   .new_(bytes, renderer.screen.width, renderer.screen.height);
+  renderer.backingCtx.call<void>("putImageData", image, 0, 0);
+}
+#endif
+
+// Frame times in ms oldest first as bars, with a line at one tick
+EM_JS(void, draw_frame_graph,
+      (emscripten::EM_VAL ctxHandle, const float *times, int count,
+       float tickMs),
+      {
+        const ctx = Emval.toValue(ctxHandle);
+        const data = HEAPF32.subarray(times >> 2, (times >> 2) + count);
+        const scale = 2;
+        const height = 3 * tickMs * scale;
+        ctx.fillStyle = "rgba(0, 0, 0, 0.6)";
+        ctx.fillRect(0, 0, count, height);
+        ctx.fillStyle = "#40c040";
+        for (let i = 0; i < count; i++) {
+          const bar = Math.min(data[i] * scale, height);
+          if (data[i] > tickMs)
+            ctx.fillStyle = "#e04040";
+          ctx.fillRect(i, height - bar, 1, bar);
+          if (data[i] > tickMs)
+            ctx.fillStyle = "#40c040";
+        }
+        ctx.fillStyle = "#ffffff";
+        ctx.fillRect(0, height - tickMs * scale, count, 1);
+      });
+
+void drawProfiler(Renderer &renderer) {
+  constexpr int GRAPH_FRAMES = 240;
+  auto &p = profile::profiler();
+  static std::vector<float> times;
+  times.clear();
+  auto frames = std::min(p.recorded(), (uint32_t)GRAPH_FRAMES);
+  for (auto age = frames; age-- > 0;)
+    times.push_back(p.frameTime[p.slot(age)] / 1e6f);
+
+  auto &ctx = renderer.backingCtx;
+  float tickMs = TICK_SECONDS * 1000.0f;
+  draw_frame_graph(ctx.as_handle(), times.data(), times.size(), tickMs);
+
+  auto top = profile::topSystems(profile::HUD_TOP_SYSTEMS);
+  auto phases = profile::phaseTimes();
+  int lines = (int)(top.size() + phases.size());
+  int y = (int)(3 * tickMs * 2) + 12;
+  ctx.set("fillStyle", emscripten::val("rgba(0, 0, 0, 0.6)"));
+  ctx.call<void>("fillRect", 0, y - 10, GRAPH_FRAMES, lines * 12 + 4);
+  ctx.set("fillStyle", emscripten::val("#ffffff"));
+  ctx.set("font", emscripten::val("10px monospace"));
+  char line[96];
+  auto print = [&](const char *name, double ns) {
+    snprintf(line, sizeof(line), "%-24.24s %7.3fms", name, ns / 1e6);
+    ctx.call<void>("fillText", emscripten::val(line), 4, y);
+    y += 12;
+  };
+  for (size_t i = 0; i < phases.size(); i++)
+    print(p.phases[i].name.c_str(), phases[i]);
+  for (auto &time : top)
+    print(time.system->name.c_str(), time.averageNs);
+}
 
 void initRenderer(flecs::iter &it) {
   printf("Starting renderer\n");
@@ -45,27 +191,45 @@ void initRenderer(flecs::iter &it) {
 
   canvas.set("width", 800);
   canvas.set("height", 600);
+  virtualCanvas.set("width", VIRTUAL_WIDTH);
+  virtualCanvas.set("height", VIRTUAL_HEIGHT);
 
   it.world().emplace<Renderer>(canvas, ctx, virtualCanvas, virtualCtx, 800,
-                               600);
+                               600, emscripten::val::array());
 }
 
 void beginFrame(Renderer &renderer) {
-  renderer.width = renderer.canvas["clientWidth"].as<int>();
-  renderer.height = renderer.canvas["clientHeight"].as<int>();
-  renderer.canvas.set("width", renderer.width);
-  renderer.canvas.set("height", renderer.height);
-
-  renderer.virtualCanvas.set("width", VIRTUAL_WIDTH);
-  renderer.virtualCanvas.set("height", VIRTUAL_HEIGHT);
+  // Setting a canvas' size reallocates it, so only done when it changed
+  int width = renderer.canvas["clientWidth"].as<int>();
+  int height = renderer.canvas["clientHeight"].as<int>();
+  if (width != renderer.width || height != renderer.height) {
+    renderer.width = width;
+    renderer.height = height;
+    renderer.canvas.set("width", width);
+    renderer.canvas.set("height", height);
+  }
 
   auto &ctx = renderer.ctx;
+  ctx.call<void>("clearRect", 0, 0, VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
   ctx.set("imageSmoothingEnabled", false);
 
   ctx.call<void>("save");
 }
+void flushDrawCommands(Renderer &renderer, const DrawCommands &draw) {
+#ifdef LD53_SOFTWARE_RENDER
+  renderer.framebuffer.resize(VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
+  clearPixels(renderer.framebuffer, 0);
+  executeCommands(renderer.framebuffer, draw.commands.data(),
+                  draw.commands.size(), renderer.pixels);
+#else
+  drawCommands(renderer.ctx, renderer, draw);
+#endif
+}
 void endFrame(Renderer &renderer) {
   renderer.ctx.call<void>("restore");
+#ifdef LD53_SOFTWARE_RENDER
+  presentPixels(renderer);
+#else
 
   auto &ctx = renderer.backingCtx;
   ctx.set("imageSmoothingEnabled", false);
@@ -93,50 +257,12 @@ void endFrame(Renderer &renderer) {
   ctx.call<void>("drawImage", renderer.virtualCanvas,
                  (renderer.width - width) / 2, (renderer.height - height) / 2,
                  width, height);
+#endif
+  if (profile::profiler().hud)
+    drawProfiler(renderer);
 }
 
-void drawBox(Renderer &renderer, const game::Position &pos) {
-  renderer.ctx.set("fillStyle", emscripten::val("red"));
-  renderer.ctx.call<void>("fillRect", pos.x, pos.y, 16, 16);
-}
-
-void drawImage(Renderer &renderer, const game::Position &pos,
-               const HTMLImage &img) {
-  renderer.ctx.call<void>("drawImage", img.image, pos.x, pos.y);
-}
-void drawImageTile(Renderer &renderer, const game::Position &pos,
-                   const HTMLImage &img, const ImageTile &tile) {
-  renderer.ctx.call<void>("drawImage", img.image, tile.x * 16, tile.y * 16, 16,
-                          16, pos.x, pos.y, 16, 16);
-}
-void drawImageAnimatedTile(flecs::entity e, Renderer &renderer,
-                           const game::Position &pos, const HTMLImage &img,
-                           const ImageTile &tile, const AnimatedTile &ani,
-                           AnimatedTileState *state) {
-  if (!state)
-    state = e.get_mut<AnimatedTileState>();
-
-  state->nextFrame -= e.delta_time() * ani.rate;
-  if (state->nextFrame <= 0) {
-    state->nextFrame += 1;
-    state->frame = (state->frame + 1) % ani.frames;
-
-    // Safety in case of lag spike/pause on brower tab
-    if (state->nextFrame <= -5)
-      state->nextFrame = 0;
-  }
-
-  renderer.ctx.call<void>("drawImage", img.image,
-                          tile.x * 16 + state->frame * 16, tile.y * 16, 16, 16,
-                          pos.x, pos.y, 16, 16);
-}
-
-void aniTest(flecs::entity e, const Renderer &renderer, game::Position &pos) {
-  pos.x += 1;
-  pos.x %= VIRTUAL_WIDTH;
-}
-
-void loadImages(flecs::entity e, const ImageAsset &asset) {
+void loadImages(flecs::entity e, Renderer &renderer, ImageAsset &asset) {
   auto document = emscripten::val::global("document");
   auto img =
       document.call<emscripten::val>("createElement", emscripten::val("img"));
@@ -146,6 +272,8 @@ void loadImages(flecs::entity e, const ImageAsset &asset) {
       "bind", emscripten::val::null(), (int)(e.remove_generation().raw_id()));
   img.call<void>("addEventListener", emscripten::val("load"), func);
 
+  asset.handle = renderer.nextHandle++;
+  renderer.images.set(asset.handle, img);
   e.emplace<HTMLImage>(img);
 }
 
@@ -153,12 +281,50 @@ void on_image_load(emscripten::val param, emscripten::val event) {
   int id = param.as<int>();
   printf("Image loaded for %d\n", id);
   auto entity = gWorld->get_alive(id);
-  entity.add<HTMLImage::IsLoaded>();
+#ifdef LD53_SOFTWARE_RENDER
+  auto renderer = gWorld->get_mut<Renderer>();
+  readPixels(*renderer, entity.get<ImageAsset>()->handle,
+             entity.get<HTMLImage>()->image);
+#endif
+  entity.add<ImageAsset::IsLoaded>();
+  wake(*gWorld);
 }
 
-void buildRoom(flecs::entity e, const game::Room &room) {
+void toggle_profiler() {
+  auto &p = profile::profiler();
+  // Wrapping every system costs two clock reads each, so it waits until
+  // someone wants to see the numbers
+  if (p.systems.empty())
+    profile::installProfiler(*gWorld);
+  p.hud = !p.hud;
+  wake(*gWorld);
+}
+
+// A resized canvas is only drawn again at the next frame, which may be a
+// while off when idle
+EM_BOOL on_resize(int type, const EmscriptenUiEvent *event, void *data) {
+  wake(*gWorld);
+  return EM_FALSE;
+}
+
+void buildRoom(flecs::entity e, Renderer &renderer, const game::Room &room) {
   printf("Building render room\n");
-  auto ecs = e.world();
+  DrawCommands commands;
+  if (!bakeRoom(e.world(), room, commands))
+    return;
+
+  // Rebuilds of a dirty room reuse the slot it already had
+  auto existing = e.get<RenderRoom>();
+  int32_t handle = existing ? existing->handle : renderer.nextHandle++;
+  e.set<RenderRoom>({handle});
+
+#ifdef LD53_SOFTWARE_RENDER
+  auto &pixels = pixelsFor(renderer, handle);
+  pixels.resize(VIRTUAL_WIDTH, VIRTUAL_HEIGHT);
+  clearPixels(pixels, 0);
+  executeCommands(pixels, commands.commands.data(), commands.commands.size(),
+                  renderer.pixels);
+#else
   auto document = emscripten::val::global("document");
   auto canvas = document.call<emscripten::val>("createElement",
                                                emscripten::val("canvas"));
@@ -166,177 +332,74 @@ void buildRoom(flecs::entity e, const game::Room &room) {
   canvas.set("width", VIRTUAL_WIDTH);
   canvas.set("height", VIRTUAL_HEIGHT);
 
-  auto wall = ecs.id<ld53::assets::Tileset::Wall>();
-  auto wallBottom = ecs.id<ld53::assets::Tileset::WallBottom>();
-
   auto ctx = canvas.call<emscripten::val>("getContext", emscripten::val("2d"));
-  for (int y = 0; y < game::ROOM_HEIGHT; y++) {
-    for (int x = 0; x < game::ROOM_WIDTH; x++) {
-      auto tile = e.world().entity(room.get_tile(x, y));
-      if (!tile)
-        continue;
-      if (!tile.has<HTMLImage::IsLoaded>()) {
-        // TODO: Handle this better?
-        printf("Not all tiles loaded\n");
-        return;
-      }
-      if (auto section = tile.get<ImageTile>()) {
-        ctx.call<void>("drawImage", tile.get<HTMLImage>()->image,
-                       section->x * 16, section->y * 16, 16, 16, x * 16, y * 16,
-                       16, 16);
-      } else {
-        ctx.call<void>("drawImage", tile.get<HTMLImage>()->image, x * 16,
-                       y * 16);
-      }
-
-      // Lighting for walls
-      if (x > 0) {
-        auto side = room.get_tile(x - 1, y);
-        if (side == wall && tile != wall) {
-          bool top = tile == wallBottom ||
-                     (y > 0 && room.get_tile(x - 1, y - 1) != wall);
-          ctx.call<void>("drawImage", tile.get<HTMLImage>()->image, 6 * 16,
-                         (top ? 0 : 1) * 16, 16, 16, x * 16, y * 16, 16, 16);
-        } else if (side == wallBottom && (tile != wall && tile != wallBottom)) {
-          ctx.call<void>("drawImage", tile.get<HTMLImage>()->image, 6 * 16,
-                         2 * 16, 16, 16, x * 16, y * 16, 16, 16);
-        }
-      }
-    }
-  }
-
-  e.emplace<RenderRoom>(canvas);
+  drawCommands(ctx, renderer, commands);
+  renderer.images.set(handle, canvas);
+#endif
 }
 
-void drawRoom(Renderer &renderer, const game::Position &pos,
-              const RenderRoom &room) {
-  renderer.ctx.call<void>("drawImage", room.canvas, pos.x, pos.y);
-}
 EMSCRIPTEN_BINDINGS(ld53) {
   emscripten::function("on_image_load", on_image_load);
+  emscripten::function("toggle_profiler", toggle_profiler);
 }
 
-void initRender(flecs::world &ecs) {
+void initRenderBackend(flecs::world &ecs) {
   ecs.component<Renderer>();
-  ecs.component<ImageAsset>().member<const char *>("path");
   ecs.component<HTMLImage>();
-  ecs.component<HTMLImage::IsLoaded>();
-  ecs.component<Image>().add(flecs::Exclusive).add(flecs::Traversable);
-  ecs.component<DependsOn>().add(flecs::Traversable);
-  ecs.component<ImageTile>().member<int>("x").member<int>("y");
-  ecs.component<AnimatedTile>().member<int>("frames").member<float>("rate");
-  ecs.component<AnimatedTileState>().member<int>("frame").member<float>(
-      "nextFrame");
-
-  ecs.component<Depth>().add(flecs::Exclusive);
-  ecs.component<Depth::Background>();
-  ecs.component<Depth::Movable>();
-  ecs.component<Depth::Player>();
 
   printf("Init renderer\n");
+  emscripten_set_resize_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, nullptr,
+                                 false, on_resize);
   ecs.system<>("initRenderer")
       .kind(flecs::OnStart)
       .write<Renderer>()
       .iter(initRenderer);
   ecs.system<Renderer>("beginFrame").kind(flecs::PreStore).each(beginFrame);
+  ecs.system<Renderer, const DrawCommands>("flushDrawCommands")
+      .kind(flecs::PostFrame)
+      .term_at(2)
+      .singleton()
+      .each(flushDrawCommands);
   ecs.system<Renderer>("endFrame").kind(flecs::PostFrame).each(endFrame);
 
-  ecs.system<Renderer, const game::Position, const RenderRoom>("drawRoom")
-      .kind(flecs::OnStore)
+  ecs.system<Renderer, ImageAsset>("loadImages")
+      .kind(flecs::PreFrame)
       .term_at(1)
       .singleton()
       .term_at(2)
-      .second<game::World>()
-      .each(drawRoom);
-
-  ecs.system<const ImageAsset>("loadImages")
-      .kind(flecs::PreFrame)
-      .term_at(1)
       .self()
       .without<HTMLImage>()
       .write<HTMLImage>()
       .each(loadImages);
-  ecs.system<Renderer, const game::Position, const HTMLImage>("drawImage")
-      .kind(flecs::OnStore)
-      .term_at(1)
-      .singleton()
-      .term_at(2)
-      .second<game::World>()
-      .term_at(3)
-      .up<Image>()
-      .with<HTMLImage::IsLoaded>()
-      .up<Image>()
-      .without<ImageTile>()
-      .self()
-      .up<Image>()
-      .each(drawImage);
-  ecs.system<Renderer, const game::Position, const HTMLImage, const ImageTile>(
-         "drawImageTile")
-      .kind(flecs::OnStore)
-      .term_at(1)
-      .singleton()
-      .term_at(2)
-      .second<game::World>()
-      .term_at(3)
-      .up<Image>()
-      .with<HTMLImage::IsLoaded>()
-      .up<Image>()
-      .term_at(4)
-      .self()
-      .up<Image>()
-      .without<AnimatedTile>()
-      .self()
-      .up<Image>()
-      .group_by<Depth>()
-      .each(drawImageTile);
-  ecs.system<Renderer, const game::Position, const HTMLImage, const ImageTile,
-             const AnimatedTile, AnimatedTileState *>("drawImageAnimatedTile")
-      .kind(flecs::OnStore)
-      .term_at(1)
-      .singleton()
-      .term_at(2)
-      .second<game::World>()
-      .term_at(3)
-      .up<Image>()
-      .with<HTMLImage::IsLoaded>()
-      .up<Image>()
-      .term_at(4)
-      .self()
-      .up<Image>()
-      .term_at(5)
-      .self()
-      .up<Image>()
-      .each(drawImageAnimatedTile);
 
-  ecs.system<Renderer, const game::Position, const HTMLImage>("drawMailIcon")
-      .kind(flecs::OnStore)
+  ecs.system<Renderer, const game::Room>("buildRoomRender")
       .term_at(1)
       .singleton()
-      .term_at(2)
-      .second<game::World>()
-      .term_at(3)
-      .up<Image>()
-      .with<HTMLImage::IsLoaded>()
-      .up<Image>()
-      .with<game::Holding>(flecs::Any)
-      .each([](Renderer &renderer, const game::Position &pos,
-               const HTMLImage &image) {
-        renderer.ctx.call<void>("drawImage", image.image, 16, 3 * 16, 16, 16,
-                                pos.x, pos.y - 8, 16, 16);
-      });
-
-  ecs.system<const game::Room>("buildRoomRender")
       .without<RenderRoom>()
       .write<RenderRoom>()
-      .with<HTMLImage::IsLoaded>()
+      .with<ImageAsset::IsLoaded>()
       .up<DependsOn>()
       .each(buildRoom);
-  ecs.system<const game::Room>("buildRoomRenderDirty")
+  ecs.system<Renderer, const game::Room>("buildRoomRenderDirty")
+      .term_at(1)
+      .singleton()
       .with<game::Room::IsDirty>()
       .write<RenderRoom>()
-      .with<HTMLImage::IsLoaded>()
+      .with<ImageAsset::IsLoaded>()
       .up<DependsOn>()
       .each(buildRoom);
+
+  ecs.observer<const RenderRoom>("releaseRoomRender")
+      .event(flecs::OnRemove)
+      .each([](flecs::entity e, const RenderRoom &room) {
+        auto renderer = e.world().get_mut<Renderer>();
+        if (!renderer)
+          return;
+        renderer->images.set(room.handle, emscripten::val::null());
+#ifdef LD53_SOFTWARE_RENDER
+        pixelsFor(*renderer, room.handle) = {};
+#endif
+      });
 }
 
-} // namespace ld53::render
\ No newline at end of file
+} // namespace ld53::render